@@ -0,0 +1,946 @@
+#include "bdd.h"
+#include "number.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define NODE_NONE        -1
+
+/* The operation cache has at least 1 << CACHE_MIN_BITS entries, and grows
+ * with the number of nodes up to 1 << CACHE_MAX_BITS. */
+#define CACHE_MIN_BITS   12
+#define CACHE_MAX_BITS   22
+
+#define SUBTABLE_MIN     8
+
+/* Unreferenced nodes are freed once there are at least GC_MIN_NODES of
+ * them, and they are at least half of all nodes. */
+#define GC_MIN_NODES     (1 << 14)
+
+/* With reordering on, the variables are sifted once there are
+ * REORDER_FIRST live nodes, then whenever their number has doubled. A
+ * variable is moved no further once the BDDs grow by SIFT_MAX_GROWTH, and
+ * only the SIFT_MAX_VARS variables with the most nodes are moved, with at
+ * most SIFT_MAX_SWAPS swaps of levels in all. */
+#define REORDER_FIRST    (1 << 12)
+#define SIFT_MAX_GROWTH  1.2
+#define SIFT_MAX_VARS    1000
+#define SIFT_MAX_SWAPS   100000
+
+enum {
+    OP_NOT,
+    OP_AND,
+    OP_OR,
+    OP_IMPLIES,
+    OP_IFF,
+    OP_RESTRICT_FALSE,
+    OP_RESTRICT_TRUE
+};
+
+typedef struct node {
+    int var;       /* num_vars for the constants, -1 for free nodes. */
+    int low;       /* The BDD for var false. */
+    int high;      /* The BDD for var true. */
+    int next;      /* Next node in the same bucket, or in the free list. */
+    int ref;       /* References from parent nodes and from the caller. */
+} node;
+
+/*
+ * The nodes of one variable, found by their children through an open
+ * hash table with chaining.
+ */
+typedef struct subtable {
+    int* buckets;
+    int  num_buckets;   /* A power of 2. */
+    int  size;
+} subtable;
+
+typedef struct cache_entry {
+    int op;
+    int a;
+    int b;
+    int result;
+} cache_entry;
+
+typedef struct bdd_manager {
+    int     num_vars;
+
+    /* Nodes 0 and 1 are the constants, and are never freed. */
+    node*   nodes;
+    int     capacity;
+    int     num_used;      /* Nodes handed out, free or not. */
+    int     free_list;
+    int     num_nodes;     /* Nodes in the subtables. */
+    int     num_dead;      /* Nodes in the subtables that are not referenced. */
+    int     max_nodes;
+    bool    reordering_now;
+
+    /* Per variable data. */
+    subtable* subtables;
+    int*    level;         /* Level of each variable, num_vars for the constants. */
+    int*    var_at;        /* Variable at each level. */
+
+    cache_entry* cache;
+    int     cache_mask;
+
+    bool    reordering;
+    int     next_reorder;  /* Number of live nodes to reorder at. */
+    int     swaps_left;    /* Swaps the current reordering may still do. */
+
+    /* Scratch space for traversals, indexed by node. */
+    unsigned* stamps;
+    unsigned  stamp;
+    int*    costs;
+    Number* counts;
+    int     scratch_capacity;
+} bdd_manager;
+
+/* ==================== Nodes =====================*/
+
+static unsigned hash_pair(int a, int b) {
+    return (unsigned)a * 12582917u ^ (unsigned)b * 4256249u;
+}
+
+static int level_of(BddManager m, int f) {
+    return m->level[m->nodes[f].var];
+}
+
+/*
+ * Count a reference to f, from a parent node or from the caller.
+ */
+int bdd_ref(BddManager m, int f) {
+    if (f > BDD_TRUE && m->nodes[f].ref++ == 0) {
+        m->num_dead--;
+    }
+    return f;
+}
+
+void bdd_deref(BddManager m, int f) {
+    if (f > BDD_TRUE && --m->nodes[f].ref == 0) {
+        m->num_dead++;
+    }
+}
+
+static void subtable_insert(BddManager m, int var, int f) {
+    subtable* t = &m->subtables[var];
+    if (t->size >= 2 * t->num_buckets) {
+        int num_buckets = 2 * t->num_buckets;
+        int* buckets = malloc(sizeof(int) * num_buckets);
+        int i, g, next;
+        for (i = 0; i < num_buckets; i++) {
+            buckets[i] = NODE_NONE;
+        }
+        for (i = 0; i < t->num_buckets; i++) {
+            for (g = t->buckets[i]; g != NODE_NONE; g = next) {
+                next = m->nodes[g].next;
+                unsigned h = hash_pair(m->nodes[g].low, m->nodes[g].high) & (num_buckets - 1);
+                m->nodes[g].next = buckets[h];
+                buckets[h] = g;
+            }
+        }
+        free(t->buckets);
+        t->buckets = buckets;
+        t->num_buckets = num_buckets;
+    }
+    unsigned h = hash_pair(m->nodes[f].low, m->nodes[f].high) & (t->num_buckets - 1);
+    m->nodes[f].next = t->buckets[h];
+    t->buckets[h] = f;
+    t->size++;
+}
+
+/*
+ * Free a node that is no longer referenced and has been taken out of its
+ * subtable, dropping its references to its children.
+ */
+static void free_node(BddManager m, int f) {
+    bdd_deref(m, m->nodes[f].low);
+    bdd_deref(m, m->nodes[f].high);
+    m->nodes[f].var = -1;
+    m->nodes[f].next = m->free_list;
+    m->free_list = f;
+    m->num_nodes--;
+    m->num_dead--;
+}
+
+/*
+ * Return the node for [var ? high : low], making it if there is none and
+ * the node limit allows it, and -1 otherwise. The children must be below
+ * the level of var.
+ */
+static int make_node(BddManager m, int var, int low, int high) {
+    if (low == high) {
+        return low;
+    }
+    subtable* t = &m->subtables[var];
+    unsigned h = hash_pair(low, high) & (t->num_buckets - 1);
+    int f;
+    for (f = t->buckets[h]; f != NODE_NONE; f = m->nodes[f].next) {
+        if (m->nodes[f].low == low && m->nodes[f].high == high) {
+            return f;
+        }
+    }
+    if (m->num_nodes >= m->max_nodes && !m->reordering_now) {
+        return -1;
+    }
+
+    if (m->free_list != NODE_NONE) {
+        f = m->free_list;
+        m->free_list = m->nodes[f].next;
+    }
+    else {
+        if (m->num_used == m->capacity) {
+            m->capacity *= 2;
+            m->nodes = realloc(m->nodes, sizeof(node) * m->capacity);
+        }
+        f = m->num_used++;
+    }
+    m->nodes[f].var = var;
+    m->nodes[f].low = bdd_ref(m, low);
+    m->nodes[f].high = bdd_ref(m, high);
+    m->nodes[f].ref = 0;
+    m->num_nodes++;
+    m->num_dead++;
+    subtable_insert(m, var, f);
+    return f;
+}
+
+/*
+ * Free all nodes that are not referenced, from the top level down, so that
+ * the children of a freed node are freed too if it was their last parent.
+ */
+static void collect_garbage(BddManager m) {
+    int i, k;
+    for (k = 0; k < m->num_vars && m->num_dead > 0; k++) {
+        subtable* t = &m->subtables[m->var_at[k]];
+        for (i = 0; i < t->num_buckets; i++) {
+            int* link = &t->buckets[i];
+            while (*link != NODE_NONE) {
+                int f = *link;
+                if (m->nodes[f].ref == 0) {
+                    *link = m->nodes[f].next;
+                    t->size--;
+                    free_node(m, f);
+                }
+                else {
+                    link = &m->nodes[f].next;
+                }
+            }
+        }
+    }
+    memset(m->cache, 0xff, sizeof(cache_entry) * (m->cache_mask + 1));
+}
+
+/* ==================== Operation Cache =====================*/
+
+static cache_entry* cache_slot(BddManager m, int op, int a, int b) {
+    unsigned h = hash_pair(a, b) ^ (unsigned)op * 2654435761u;
+    return &m->cache[(h ^ h >> 15) & m->cache_mask];
+}
+
+static int cache_lookup(BddManager m, int op, int a, int b) {
+    cache_entry* e = cache_slot(m, op, a, b);
+    return e->op == op && e->a == a && e->b == b ? e->result : NODE_NONE;
+}
+
+static void cache_insert(BddManager m, int op, int a, int b, int result) {
+    cache_entry* e = cache_slot(m, op, a, b);
+    e->op = op;
+    e->a = a;
+    e->b = b;
+    e->result = result;
+}
+
+/*
+ * Make the cache at least as large as the number of nodes, within bounds.
+ * Entries are lost when it grows.
+ */
+static void grow_cache(BddManager m) {
+    int size = m->cache_mask + 1;
+    if (size >= m->num_nodes || size >= 1 << CACHE_MAX_BITS) {
+        return;
+    }
+    while (size < m->num_nodes && size < 1 << CACHE_MAX_BITS) {
+        size *= 2;
+    }
+    free(m->cache);
+    m->cache = malloc(sizeof(cache_entry) * size);
+    memset(m->cache, 0xff, sizeof(cache_entry) * size);
+    m->cache_mask = size - 1;
+}
+
+/* ==================== Manager =====================*/
+
+/*
+ * Make a manager for num_vars variables, holding at most max_nodes nodes.
+ */
+BddManager bdd_new(int num_vars, int max_nodes) {
+    BddManager m = calloc(1, sizeof(bdd_manager));
+    int i;
+    m->num_vars = num_vars;
+    m->capacity = 1024;
+    m->nodes = malloc(sizeof(node) * m->capacity);
+    for (i = 0; i < 2; i++) {
+        m->nodes[i].var = num_vars;
+        m->nodes[i].low = i;
+        m->nodes[i].high = i;
+        m->nodes[i].next = NODE_NONE;
+        m->nodes[i].ref = 1;
+    }
+    m->num_used = 2;
+    m->free_list = NODE_NONE;
+    m->max_nodes = max_nodes;
+
+    m->subtables = malloc(sizeof(subtable) * num_vars);
+    m->level = malloc(sizeof(int) * (num_vars + 1));
+    m->var_at = malloc(sizeof(int) * (num_vars + 1));
+    for (i = 0; i < num_vars; i++) {
+        m->subtables[i].num_buckets = SUBTABLE_MIN;
+        m->subtables[i].buckets = malloc(sizeof(int) * SUBTABLE_MIN);
+        memset(m->subtables[i].buckets, 0xff, sizeof(int) * SUBTABLE_MIN);
+        m->subtables[i].size = 0;
+    }
+    for (i = 0; i <= num_vars; i++) {
+        m->level[i] = i;
+        m->var_at[i] = i;
+    }
+
+    m->cache_mask = (1 << CACHE_MIN_BITS) - 1;
+    m->cache = malloc(sizeof(cache_entry) << CACHE_MIN_BITS);
+    memset(m->cache, 0xff, sizeof(cache_entry) << CACHE_MIN_BITS);
+    m->next_reorder = REORDER_FIRST;
+    return m;
+}
+
+void bdd_free(BddManager m) {
+    if (m == NULL) {
+        return;
+    }
+    int i;
+    for (i = 0; i < m->num_vars; i++) {
+        free(m->subtables[i].buckets);
+    }
+    free(m->subtables);
+    free(m->level);
+    free(m->var_at);
+    free(m->nodes);
+    free(m->cache);
+    free(m->stamps);
+    free(m->costs);
+    free(m->counts);
+    free(m);
+}
+
+/*
+ * Turn on or off the reordering of the variables by sifting as the BDDs
+ * grow.
+ */
+void bdd_set_reordering(BddManager m, bool on) {
+    m->reordering = on;
+}
+
+int bdd_num_nodes(BddManager m) {
+    return m->num_nodes - m->num_dead;
+}
+
+/*
+ * Return the level of the top variable of f, num_vars for the constants.
+ */
+int bdd_level(BddManager m, int f) {
+    return level_of(m, f);
+}
+
+/*
+ * Free unreferenced nodes, and reorder the variables if it is time to,
+ * before an operation.
+ */
+static void start_operation(BddManager m) {
+    if (m->reordering && m->num_nodes - m->num_dead >= m->next_reorder) {
+        bdd_reorder(m);
+        m->next_reorder = 2 * (m->num_nodes - m->num_dead);
+        if (m->next_reorder < REORDER_FIRST) {
+            m->next_reorder = REORDER_FIRST;
+        }
+    }
+    else if (m->num_dead >= GC_MIN_NODES && m->num_dead >= m->num_nodes / 2) {
+        collect_garbage(m);
+    }
+    grow_cache(m);
+}
+
+/*
+ * After an operation that ran out of nodes, free the unreferenced ones
+ * and, with reordering on, reorder. Return true if the operation is worth
+ * trying again.
+ */
+static bool recover(BddManager m) {
+    int before = m->num_nodes;
+    collect_garbage(m);
+    if (m->reordering) {
+        bdd_reorder(m);
+    }
+    return m->num_nodes < before;
+}
+
+/* ==================== Operations =====================*/
+
+static int negate(BddManager m, int f) {
+    if (f <= BDD_TRUE) {
+        return !f;
+    }
+    int r = cache_lookup(m, OP_NOT, f, 0);
+    if (r != NODE_NONE) {
+        return r;
+    }
+    int low = negate(m, m->nodes[f].low);
+    if (low < 0) {
+        return -1;
+    }
+    int high = negate(m, m->nodes[f].high);
+    if (high < 0) {
+        return -1;
+    }
+    r = make_node(m, m->nodes[f].var, low, high);
+    if (r >= 0) {
+        cache_insert(m, OP_NOT, f, 0, r);
+    }
+    return r;
+}
+
+static int apply(BddManager m, int op, int f, int g) {
+    switch (op) {
+        case OP_AND:
+            if (f == BDD_FALSE || g == BDD_FALSE) {
+                return BDD_FALSE;
+            }
+            if (f == BDD_TRUE || f == g) {
+                return g;
+            }
+            if (g == BDD_TRUE) {
+                return f;
+            }
+            break;
+        case OP_OR:
+            if (f == BDD_TRUE || g == BDD_TRUE) {
+                return BDD_TRUE;
+            }
+            if (f == BDD_FALSE || f == g) {
+                return g;
+            }
+            if (g == BDD_FALSE) {
+                return f;
+            }
+            break;
+        case OP_IMPLIES:
+            if (f == BDD_FALSE || g == BDD_TRUE || f == g) {
+                return BDD_TRUE;
+            }
+            if (f == BDD_TRUE) {
+                return g;
+            }
+            if (g == BDD_FALSE) {
+                return negate(m, f);
+            }
+            break;
+        default:
+            if (f == g) {
+                return BDD_TRUE;
+            }
+            if (f == BDD_TRUE || g == BDD_TRUE) {
+                return f == BDD_TRUE ? g : f;
+            }
+            if (f == BDD_FALSE || g == BDD_FALSE) {
+                return negate(m, f == BDD_FALSE ? g : f);
+            }
+            break;
+    }
+    if (op != OP_IMPLIES && g < f) {
+        int h = f;
+        f = g;
+        g = h;
+    }
+    int r = cache_lookup(m, op, f, g);
+    if (r != NODE_NONE) {
+        return r;
+    }
+
+    int level_f = level_of(m, f);
+    int level_g = level_of(m, g);
+    int top = level_f < level_g ? level_f : level_g;
+    int f0 = level_f == top ? m->nodes[f].low : f;
+    int f1 = level_f == top ? m->nodes[f].high : f;
+    int g0 = level_g == top ? m->nodes[g].low : g;
+    int g1 = level_g == top ? m->nodes[g].high : g;
+    int low = apply(m, op, f0, g0);
+    if (low < 0) {
+        return -1;
+    }
+    int high = apply(m, op, f1, g1);
+    if (high < 0) {
+        return -1;
+    }
+    r = make_node(m, m->var_at[top], low, high);
+    if (r >= 0) {
+        cache_insert(m, op, f, g, r);
+    }
+    return r;
+}
+
+static int restrict_var(BddManager m, int f, int var, bool value) {
+    int level = m->level[var];
+    if (level_of(m, f) > level) {
+        return f;
+    }
+    if (level_of(m, f) == level) {
+        return value ? m->nodes[f].high : m->nodes[f].low;
+    }
+    int op = value ? OP_RESTRICT_TRUE : OP_RESTRICT_FALSE;
+    int r = cache_lookup(m, op, f, var);
+    if (r != NODE_NONE) {
+        return r;
+    }
+    int low = restrict_var(m, m->nodes[f].low, var, value);
+    if (low < 0) {
+        return -1;
+    }
+    int high = restrict_var(m, m->nodes[f].high, var, value);
+    if (high < 0) {
+        return -1;
+    }
+    r = make_node(m, m->nodes[f].var, low, high);
+    if (r >= 0) {
+        cache_insert(m, op, f, var, r);
+    }
+    return r;
+}
+
+/*
+ * Run a binary operation from the top, trying again once if it runs out
+ * of nodes and freeing or reordering has made room.
+ */
+static int run_operation(BddManager m, int op, int f, int g) {
+    start_operation(m);
+    int r = op == OP_NOT ? negate(m, f) : apply(m, op, f, g);
+    if (r < 0 && recover(m)) {
+        r = op == OP_NOT ? negate(m, f) : apply(m, op, f, g);
+    }
+    return r;
+}
+
+int bdd_var(BddManager m, int var) {
+    start_operation(m);
+    return make_node(m, var, BDD_FALSE, BDD_TRUE);
+}
+
+int bdd_not(BddManager m, int f) {
+    return run_operation(m, OP_NOT, f, 0);
+}
+
+int bdd_and(BddManager m, int f, int g) {
+    return run_operation(m, OP_AND, f, g);
+}
+
+int bdd_or(BddManager m, int f, int g) {
+    return run_operation(m, OP_OR, f, g);
+}
+
+int bdd_implies(BddManager m, int f, int g) {
+    return run_operation(m, OP_IMPLIES, f, g);
+}
+
+int bdd_iff(BddManager m, int f, int g) {
+    return run_operation(m, OP_IFF, f, g);
+}
+
+/*
+ * Return f with the variable var set to value.
+ */
+int bdd_restrict(BddManager m, int f, int var, bool value) {
+    start_operation(m);
+    int r = restrict_var(m, f, var, value);
+    if (r < 0 && recover(m)) {
+        r = restrict_var(m, f, var, value);
+    }
+    return r;
+}
+
+/* ==================== Counting and Models =====================*/
+
+/*
+ * Start a traversal: nodes whose stamp is not the new one have no value
+ * computed yet.
+ */
+static void start_traversal(BddManager m) {
+    if (m->scratch_capacity < m->num_used) {
+        m->scratch_capacity = m->capacity;
+        free(m->stamps);
+        m->stamps = calloc(sizeof(unsigned), m->scratch_capacity);
+        m->costs = realloc(m->costs, sizeof(int) * m->scratch_capacity);
+        m->counts = realloc(m->counts, sizeof(Number) * m->scratch_capacity);
+        m->stamp = 0;
+    }
+    if (++m->stamp == 0) {
+        memset(m->stamps, 0, sizeof(unsigned) * m->scratch_capacity);
+        m->stamp = 1;
+    }
+}
+
+/*
+ * Number of assignments of the variables from the level of f down that
+ * satisfy f, kept in counts until bdd_count() is done.
+ */
+static Number count_below(BddManager m, int f) {
+    if (m->stamps[f] == m->stamp) {
+        return m->counts[f];
+    }
+    Number count;
+    if (f <= BDD_TRUE) {
+        count = number_new(f);
+    }
+    else {
+        int level = level_of(m, f);
+        int low = m->nodes[f].low;
+        int high = m->nodes[f].high;
+        Number low_count = number_shift(count_below(m, low), level_of(m, low) - level - 1);
+        Number high_count = number_shift(count_below(m, high), level_of(m, high) - level - 1);
+        count = number_add(low_count, high_count);
+        number_free(low_count);
+        number_free(high_count);
+    }
+    m->stamps[f] = m->stamp;
+    m->counts[f] = count;
+    return count;
+}
+
+/*
+ * Return the number of assignments of all variables that satisfy f, in
+ * decimal, to be freed by the caller.
+ */
+char* bdd_count(BddManager m, int f) {
+    start_traversal(m);
+    Number count = number_shift(count_below(m, f), level_of(m, f));
+    char* digits = number_string(count);
+    number_free(count);
+    int i;
+    for (i = 0; i < m->num_used; i++) {
+        if (m->stamps[i] == m->stamp) {
+            number_free(m->counts[i]);
+        }
+    }
+    return digits;
+}
+
+/*
+ * Fewest true variables in an assignment satisfying f below its level, or
+ * INT32_MAX if there is none, as computed last.
+ */
+static int cost_of(BddManager m, int f) {
+    return f <= BDD_TRUE ? (f == BDD_TRUE ? 0 : INT32_MAX) : m->costs[f];
+}
+
+/*
+ * Find an assignment that satisfies f with the fewest true variables and,
+ * among those, makes false the variables first listed in priority (a list
+ * of all variables), as far as possible, and set values to it. Return
+ * false if f is not satisfiable.
+ *
+ * The assignments with the fewest true variables are the paths that only
+ * follow edges that keep the cost, skipped variables being false. Going
+ * through priority, variables that are false or true on all those paths
+ * are settled at once; the first that can be either is made false, which
+ * drops the paths where it is true, and the costs are computed again.
+ * Nodes are never made, so this cannot run out of them.
+ */
+bool bdd_min_model(BddManager m, int f, const int* priority, bool* values) {
+    int n = m->num_vars;
+    int i, k;
+    for (i = 0; i < n; i++) {
+        values[i] = false;
+    }
+    if (f == BDD_FALSE) {
+        return false;
+    }
+
+    /* 1. List the nodes of f by level. */
+    start_traversal(m);
+    int* list = malloc(sizeof(int) * (m->num_nodes + 1));
+    int num_list = 0;
+    int top = 0;
+    if (f > BDD_TRUE) {
+        m->stamps[f] = m->stamp;
+        list[top++] = f;
+    }
+    while (top > num_list) {
+        int g = list[num_list++];
+        int children[2] = {m->nodes[g].low, m->nodes[g].high};
+        for (k = 0; k < 2; k++) {
+            if (children[k] > BDD_TRUE && m->stamps[children[k]] != m->stamp) {
+                m->stamps[children[k]] = m->stamp;
+                list[top++] = children[k];
+            }
+        }
+    }
+    int* first = calloc(sizeof(int), n + 2);
+    for (i = 0; i < num_list; i++) {
+        first[level_of(m, list[i]) + 1]++;
+    }
+    for (i = 0; i < n; i++) {
+        first[i + 1] += first[i];
+    }
+    int* order = malloc(sizeof(int) * (num_list + 1));
+    for (i = 0; i < num_list; i++) {
+        order[first[level_of(m, list[i])]++] = list[i];
+    }
+    free(list);
+    free(first);
+
+    bool* made_false = calloc(sizeof(bool), n);
+    bool* can_true = malloc(sizeof(bool) * n);
+    bool* can_false = malloc(sizeof(bool) * n);
+    int* skipped = malloc(sizeof(int) * (n + 1));
+    int next = 0;
+    while (true) {
+        /* 2. Fewest true variables below each node, bottom up. */
+        for (i = num_list - 1; i >= 0; i--) {
+            int g = order[i];
+            int low = cost_of(m, m->nodes[g].low);
+            int high = cost_of(m, m->nodes[g].high);
+            if (made_false[m->nodes[g].var] || high == INT32_MAX) {
+                high = INT32_MAX;
+            }
+            else {
+                high++;
+            }
+            m->costs[g] = low < high ? low : high;
+        }
+
+        /* 3. Follow the edges that keep the cost from the root, top down,
+         *    noting the values each variable can take. Skipped levels are
+         *    counted in skipped, as differences. */
+        memset(can_true, 0, sizeof(bool) * n);
+        memset(can_false, 0, sizeof(bool) * n);
+        memset(skipped, 0, sizeof(int) * (n + 1));
+        skipped[0]++;
+        skipped[level_of(m, f)]--;
+        start_traversal(m);
+        if (f > BDD_TRUE) {
+            m->stamps[f] = m->stamp;
+        }
+        for (i = 0; i < num_list; i++) {
+            int g = order[i];
+            if (m->stamps[g] != m->stamp) {
+                continue;
+            }
+            int var = m->nodes[g].var;
+            int level = m->level[var];
+            for (k = 0; k < 2; k++) {
+                int child = k == 0 ? m->nodes[g].low : m->nodes[g].high;
+                int cost = cost_of(m, child);
+                if (cost == INT32_MAX || (k == 1 && made_false[var]) ||
+                    cost + k != m->costs[g]) {
+                    continue;
+                }
+                if (k == 0) {
+                    can_false[var] = true;
+                }
+                else {
+                    can_true[var] = true;
+                }
+                skipped[level + 1]++;
+                skipped[level_of(m, child)]--;
+                if (child > BDD_TRUE) {
+                    m->stamps[child] = m->stamp;
+                }
+            }
+        }
+        int depth = 0;
+        for (i = 0; i < n; i++) {
+            depth += skipped[i];
+            if (depth > 0) {
+                can_false[m->var_at[i]] = true;
+            }
+        }
+
+        /* 4. Settle variables until one can be either. */
+        int open = -1;
+        while (next < n && open == -1) {
+            int var = priority[next++];
+            if (can_true[var] && can_false[var]) {
+                made_false[var] = true;
+                open = var;
+            }
+            else {
+                values[var] = can_true[var];
+            }
+        }
+        if (open == -1) {
+            break;
+        }
+    }
+    free(skipped);
+    free(can_false);
+    free(can_true);
+    free(made_false);
+    free(order);
+    return true;
+}
+
+/* ==================== Reordering =====================*/
+
+/*
+ * Swap the variables at levels i and i + 1, keeping the function of every
+ * node: a node of the upper variable x whose children depend on the lower
+ * variable y becomes a node of y, with new nodes of x as children.
+ */
+static void swap_levels(BddManager m, int i) {
+    int x = m->var_at[i];
+    int y = m->var_at[i + 1];
+    subtable* tx = &m->subtables[x];
+
+    /* 1. Take all nodes out of the subtable of x. */
+    int* list = malloc(sizeof(int) * (tx->size + 1));
+    int num_list = 0;
+    int k, f;
+    for (k = 0; k < tx->num_buckets; k++) {
+        for (f = tx->buckets[k]; f != NODE_NONE; f = m->nodes[f].next) {
+            list[num_list++] = f;
+        }
+        tx->buckets[k] = NODE_NONE;
+    }
+    tx->size = 0;
+
+    /* 2. Nodes that do not depend on y stay nodes of x; the others are
+     *    kept at the start of the list. */
+    int num_moved = 0;
+    for (k = 0; k < num_list; k++) {
+        f = list[k];
+        if (m->nodes[m->nodes[f].low].var != y && m->nodes[m->nodes[f].high].var != y) {
+            subtable_insert(m, x, f);
+        }
+        else {
+            list[num_moved++] = f;
+        }
+    }
+
+    /* 3. Rebuild the others as nodes of y. */
+    for (k = 0; k < num_moved; k++) {
+        f = list[k];
+        int f0 = m->nodes[f].low;
+        int f1 = m->nodes[f].high;
+        int f00 = m->nodes[f0].var == y ? m->nodes[f0].low : f0;
+        int f01 = m->nodes[f0].var == y ? m->nodes[f0].high : f0;
+        int f10 = m->nodes[f1].var == y ? m->nodes[f1].low : f1;
+        int f11 = m->nodes[f1].var == y ? m->nodes[f1].high : f1;
+        int low = bdd_ref(m, make_node(m, x, f00, f10));
+        int high = bdd_ref(m, make_node(m, x, f01, f11));
+        bdd_deref(m, f0);
+        bdd_deref(m, f1);
+        m->nodes[f].var = y;
+        m->nodes[f].low = low;
+        m->nodes[f].high = high;
+        subtable_insert(m, y, f);
+    }
+    free(list);
+
+    /* 4. Free the nodes of y that no node uses any more. */
+    subtable* ty = &m->subtables[y];
+    for (k = 0; k < ty->num_buckets; k++) {
+        int* link = &ty->buckets[k];
+        while (*link != NODE_NONE) {
+            f = *link;
+            if (m->nodes[f].ref == 0) {
+                *link = m->nodes[f].next;
+                ty->size--;
+                free_node(m, f);
+            }
+            else {
+                link = &m->nodes[f].next;
+            }
+        }
+    }
+
+    m->var_at[i] = y;
+    m->var_at[i + 1] = x;
+    m->level[x] = i + 1;
+    m->level[y] = i;
+    m->swaps_left--;
+}
+
+/*
+ * Move var to every level, as long as the BDDs do not grow too much and
+ * swaps are left, then back to the level where they were smallest.
+ */
+static void sift(BddManager m, int var) {
+    int best_size = bdd_num_nodes(m);
+    int best_level = m->level[var];
+    int limit = (int)(best_size * SIFT_MAX_GROWTH);
+    int last = m->num_vars - 1;
+    int pass;
+
+    /* Go to the nearer end first. */
+    bool down = m->level[var] >= m->num_vars / 2;
+    for (pass = 0; pass < 2; pass++, down = !down) {
+        while ((down ? m->level[var] < last : m->level[var] > 0) && m->swaps_left > 0) {
+            swap_levels(m, down ? m->level[var] : m->level[var] - 1);
+            int size = bdd_num_nodes(m);
+            if (size < best_size) {
+                best_size = size;
+                best_level = m->level[var];
+            }
+            if (size > limit) {
+                break;
+            }
+        }
+    }
+    while (m->level[var] < best_level) {
+        swap_levels(m, m->level[var]);
+    }
+    while (m->level[var] > best_level) {
+        swap_levels(m, m->level[var] - 1);
+    }
+}
+
+typedef struct var_size {
+    int var;
+    int size;
+} var_size;
+
+/*
+ * Order variables by decreasing number of nodes, then by number.
+ */
+static int compare_sizes(const void* a, const void* b) {
+    const var_size* x = a;
+    const var_size* y = b;
+    if (x->size != y->size) {
+        return x->size > y->size ? -1 : 1;
+    }
+    return x->var - y->var;
+}
+
+/*
+ * Reorder the variables by sifting each, those with most nodes first.
+ */
+void bdd_reorder(BddManager m) {
+    collect_garbage(m);
+    var_size* vars = malloc(sizeof(var_size) * m->num_vars);
+    int num_vars = 0;
+    int i;
+    for (i = 0; i < m->num_vars; i++) {
+        if (m->subtables[i].size > 0) {
+            vars[num_vars].var = i;
+            vars[num_vars++].size = m->subtables[i].size;
+        }
+    }
+    qsort(vars, num_vars, sizeof(var_size), compare_sizes);
+    if (num_vars > SIFT_MAX_VARS) {
+        num_vars = SIFT_MAX_VARS;
+    }
+
+    m->reordering_now = true;
+    m->swaps_left = SIFT_MAX_SWAPS;
+    for (i = 0; i < num_vars && m->swaps_left > 0; i++) {
+        sift(m, vars[i].var);
+    }
+    m->reordering_now = false;
+    free(vars);
+    collect_garbage(m);
+}
@@ -0,0 +1,43 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include <stdbool.h>
+
+/*
+ * Reduced ordered binary decision diagrams.
+ *
+ * Variables are numbered from 0 to num_vars - 1, and are first ordered by
+ * number. A BDD is given by the index of its root node: BDD_FALSE and
+ * BDD_TRUE are the constants, and -1 is returned by an operation that
+ * would make the manager hold more than its node limit.
+ *
+ * Nodes are reference counted. The operands of an operation must be
+ * referenced by the caller, whose result is returned unreferenced: it must
+ * be referenced with bdd_ref() before the next operation, which may free
+ * the unreferenced nodes or, with reordering on, change the order of the
+ * variables. Reordering keeps the function of every referenced BDD.
+ */
+#define BDD_FALSE 0
+#define BDD_TRUE  1
+
+typedef struct bdd_manager *BddManager;
+
+BddManager bdd_new(int, int);
+void bdd_free(BddManager);
+void bdd_set_reordering(BddManager, bool);
+void bdd_reorder(BddManager);
+int bdd_var(BddManager, int);
+int bdd_ref(BddManager, int);
+void bdd_deref(BddManager, int);
+int bdd_not(BddManager, int);
+int bdd_and(BddManager, int, int);
+int bdd_or(BddManager, int, int);
+int bdd_implies(BddManager, int, int);
+int bdd_iff(BddManager, int, int);
+int bdd_restrict(BddManager, int, int, bool);
+int bdd_num_nodes(BddManager);
+int bdd_level(BddManager, int);
+char *bdd_count(BddManager, int);
+bool bdd_min_model(BddManager, int, const int *, bool *);
+
+#endif
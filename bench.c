@@ -0,0 +1,380 @@
+/*
+ * Benchmarks for the formula engine.
+ *
+ * Build with the other sources of reason, without reason.c:
+ *
+ *     gcc -std=c99 -O2 -pthread -o bench bench.c logic.c sat.c bdd.c count.c number.c
+ *
+ * A random vocabulary (names.txt, predicates.txt) is written to a
+ * directory and loaded once. Then, for each number of atoms and each
+ * depth of the grid, random formulas over that many ground atoms, and a
+ * random interpretation with the given proportion of true atoms, are
+ * generated, and each of parsing, syntax checking, is_true and
+ * is_satisfiable is timed over all the formulas.
+ *
+ * There is one JSON object per line on standard output for each operation
+ * and grid point, with its time per operation, throughput and the peak
+ * resident set size of the process so far.
+ *
+ * Options (lists are separated by commas):
+ *     --dir path            where to write the generated files (/tmp)
+ *     --names n             number of names (64)
+ *     --predicates n        number of predicates (16)
+ *     --max-arity n         predicates have arities 0 to n (3)
+ *     --atoms list          numbers of distinct atoms (8,16,64,256)
+ *     --depths list         depths of the formulas (4,8,12)
+ *     --facts p             proportion of true atoms (0.5)
+ *     --mix a:o:i:e:n       weights of and, or, implies, iff, not (1:1:1:1:1)
+ *     --formulas n          formulas per grid point (200)
+ *     --seed n              seed of the generator (1)
+ *     --engine name         how is_satisfiable decides, as for set_engine() (auto)
+ */
+
+/* For strdup() and clock_gettime() under plain C99. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "logic.h"
+
+#define MAX_GRID 32
+
+/* ==================== Random Generation =====================*/
+
+static uint64_t rng_state;
+
+/* A xorshift64* generator, so that runs can be reproduced anywhere. */
+uint64_t next_random() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+int random_below(int n) {
+    return (int)(next_random() % (uint64_t)n);
+}
+
+double random_unit() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * A growable string.
+ */
+typedef struct {
+    char*  data;
+    size_t size;
+    size_t capacity;
+} TEXT;
+
+void text_append(TEXT* text, const char* str) {
+    size_t len = strlen(str);
+    if (text->size + len + 1 > text->capacity) {
+        while (text->size + len + 1 > text->capacity) {
+            text->capacity = text->capacity == 0 ? 256 : 2 * text->capacity;
+        }
+        text->data = realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->size, str, len + 1);
+    text->size += len;
+}
+
+/* Arities of the generated predicates. */
+static int* arities;
+static int  num_predicates;
+static int  num_names;
+
+/* Weights of and, or, implies, iff and not. */
+static double mix[5] = {1, 1, 1, 1, 1};
+static const char* connectives[4] = {"and", "or", "implies", "iff"};
+
+/*
+ * Write a vocabulary of names n0, n1, ... and predicates p0/a0, p1/a1, ...
+ * to the directory, and load it.
+ */
+int make_vocabulary(const char* dir, int max_arity) {
+    char path[4096];
+    int i;
+    snprintf(path, sizeof(path), "%s/names.txt", dir);
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    for (i = 0; i < num_names; i++) {
+        fprintf(file, "n%d%c", i, i % 16 == 15 ? '\n' : ' ');
+    }
+    fclose(file);
+    if (!load_constants(path)) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/predicates.txt", dir);
+    file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    arities = malloc(sizeof(int) * num_predicates);
+    for (i = 0; i < num_predicates; i++) {
+        arities[i] = random_below(max_arity + 1);
+        fprintf(file, "p%d/%d\n", i, arities[i]);
+    }
+    fclose(file);
+    return load_predicates(path);
+}
+
+/*
+ * Store in atoms the text of num_atoms distinct random ground atoms.
+ */
+void make_atoms(char** atoms, int num_atoms) {
+    int i = 0;
+    while (i < num_atoms) {
+        char atom[256];
+        int predicate = random_below(num_predicates);
+        int len = snprintf(atom, sizeof(atom), "p%d", predicate);
+        int k;
+        for (k = 0; k < arities[predicate]; k++) {
+            len += snprintf(atom + len, sizeof(atom) - len, "%cn%d",
+                            k == 0 ? '(' : ',', random_below(num_names));
+        }
+        if (arities[predicate] > 0) {
+            snprintf(atom + len, sizeof(atom) - len, ")");
+        }
+        int j;
+        for (j = 0; j < i && strcmp(atoms[j], atom) != 0; j++) {
+        }
+        /* With a small vocabulary there may be fewer atoms than asked. */
+        if (j == i || random_below(1000) == 0) {
+            atoms[i++] = strdup(atom);
+        }
+    }
+}
+
+/*
+ * Append a random formula of the given depth over the atoms to the text.
+ */
+void make_random_formula(TEXT* text, char** atoms, int num_atoms, int depth) {
+    if (depth == 0) {
+        text_append(text, atoms[random_below(num_atoms)]);
+        return;
+    }
+    double total = mix[0] + mix[1] + mix[2] + mix[3] + mix[4];
+    double r = random_unit() * total;
+    int op = 0;
+    while (op < 4 && r >= mix[op]) {
+        r -= mix[op];
+        op++;
+    }
+    if (op == 4) {
+        text_append(text, "not ");
+        make_random_formula(text, atoms, num_atoms, depth - 1);
+        return;
+    }
+    text_append(text, "[");
+    make_random_formula(text, atoms, num_atoms, depth - 1);
+    text_append(text, " ");
+    text_append(text, connectives[op]);
+    text_append(text, " ");
+    make_random_formula(text, atoms, num_atoms, depth - 1);
+    text_append(text, "]");
+}
+
+/* ==================== Measurement =====================*/
+
+double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/*
+ * Print the result of timing num_ops operations of a grid point. bytes is
+ * the size of the input they went through, 0 if it does not apply.
+ */
+void report(const char* op, int atoms, int depth, int num_ops, double ns,
+            size_t bytes, int count) {
+    printf("{\"op\": \"%s\", \"atoms\": %d, \"depth\": %d, \"formulas\": %d, "
+           "\"ns_per_op\": %.1f, \"ops_per_s\": %.1f",
+           op, atoms, depth, num_ops, ns / num_ops, num_ops / (ns / 1e9));
+    if (bytes > 0) {
+        printf(", \"mb_per_s\": %.2f", bytes / (ns / 1e9) / 1e6);
+    }
+    printf(", \"count\": %d, \"peak_rss_kb\": %ld}\n", count, peak_rss_kb());
+    fflush(stdout);
+}
+
+int parse_list(char* str, int* list) {
+    int n = 0;
+    char* token = strtok(str, ",");
+    while (token != NULL && n < MAX_GRID) {
+        list[n++] = atoi(token);
+        token = strtok(NULL, ",");
+    }
+    return n;
+}
+
+/*
+ * Time all operations on num_formulas random formulas of the given depth
+ * over num_atoms atoms.
+ */
+void run_grid_point(const char* dir, int num_atoms, int depth, int num_formulas,
+                    double facts) {
+    char path[4096];
+    char** atoms = malloc(sizeof(char*) * num_atoms);
+    make_atoms(atoms, num_atoms);
+    int i;
+
+    /* 1. Write the interpretation and the formulas. */
+    snprintf(path, sizeof(path), "%s/true_atoms.txt", dir);
+    FILE* file = fopen(path, "w");
+    for (i = 0; i < num_atoms; i++) {
+        if (random_unit() < facts) {
+            fprintf(file, "%s\n", atoms[i]);
+        }
+    }
+    fclose(file);
+    Interpretation interp = load_interpretation(path);
+
+    snprintf(path, sizeof(path), "%s/formulas.txt", dir);
+    file = fopen(path, "w");
+    size_t bytes = 0;
+    for (i = 0; i < num_formulas; i++) {
+        TEXT text = {NULL, 0, 0};
+        make_random_formula(&text, atoms, num_atoms, depth);
+        fprintf(file, "%s\n", text.data);
+        bytes += text.size + 1;
+        free(text.data);
+    }
+    fclose(file);
+
+    /* 2. Time each operation over all the formulas. */
+    Formula* formulas = malloc(sizeof(Formula) * num_formulas);
+    Formula form;
+    int count = 0;
+    file = fopen(path, "r");
+    double start = now_ns();
+    /* Read to the end, so that the next file is read from its start. */
+    while (next_formula(file, '\n', &form)) {
+        formulas[count++] = form;
+    }
+    report("parse", num_atoms, depth, count, now_ns() - start, bytes, count);
+    fclose(file);
+
+    int correct = 0;
+    start = now_ns();
+    for (i = 0; i < count; i++) {
+        correct += is_syntactically_correct(formulas[i]);
+    }
+    report("is_syntactically_correct", num_atoms, depth, count, now_ns() - start, 0, correct);
+
+    int num_true = 0;
+    start = now_ns();
+    for (i = 0; i < count; i++) {
+        num_true += is_true(formulas[i], interp);
+    }
+    report("is_true", num_atoms, depth, count, now_ns() - start, 0, num_true);
+
+    int satisfiable = 0;
+    start = now_ns();
+    for (i = 0; i < count; i++) {
+        satisfiable += is_satisfiable(formulas[i]);
+    }
+    report("is_satisfiable", num_atoms, depth, count, now_ns() - start, 0, satisfiable);
+
+    for (i = 0; i < count; i++) {
+        formula_free(formulas[i]);
+    }
+    free(formulas);
+    for (i = 0; i < num_atoms; i++) {
+        free(atoms[i]);
+    }
+    free(atoms);
+}
+
+int main(int argc, char** argv) {
+    const char* dir = "/tmp";
+    int max_arity = 3;
+    int atoms[MAX_GRID] = {8, 16, 64, 256};
+    int num_atoms = 4;
+    int depths[MAX_GRID] = {4, 8, 12};
+    int num_depths = 3;
+    double facts = 0.5;
+    int num_formulas = 200;
+    num_names = 64;
+    num_predicates = 16;
+    rng_state = 1;
+    int i, j;
+    for (i = 1; i < argc; i++) {
+        if (i + 1 == argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        char* value = argv[++i];
+        if (!strcmp(argv[i - 1], "--dir")) {
+            dir = value;
+        }
+        else if (!strcmp(argv[i - 1], "--names")) {
+            num_names = atoi(value);
+        }
+        else if (!strcmp(argv[i - 1], "--predicates")) {
+            num_predicates = atoi(value);
+        }
+        else if (!strcmp(argv[i - 1], "--max-arity")) {
+            max_arity = atoi(value);
+        }
+        else if (!strcmp(argv[i - 1], "--atoms")) {
+            num_atoms = parse_list(value, atoms);
+        }
+        else if (!strcmp(argv[i - 1], "--depths")) {
+            num_depths = parse_list(value, depths);
+        }
+        else if (!strcmp(argv[i - 1], "--facts")) {
+            facts = atof(value);
+        }
+        else if (!strcmp(argv[i - 1], "--mix")) {
+            sscanf(value, "%lf:%lf:%lf:%lf:%lf", &mix[0], &mix[1], &mix[2], &mix[3], &mix[4]);
+        }
+        else if (!strcmp(argv[i - 1], "--formulas")) {
+            num_formulas = atoi(value);
+        }
+        else if (!strcmp(argv[i - 1], "--seed")) {
+            rng_state = strtoull(value, NULL, 10) | 1;
+        }
+        else if (!strcmp(argv[i - 1], "--engine")) {
+            if (!set_engine(value)) {
+                fprintf(stderr, "Unknown engine %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (num_names < 1 || num_predicates < 1 || num_formulas < 1) {
+        fprintf(stderr, "There must be at least one name, predicate and formula.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!make_vocabulary(dir, max_arity)) {
+        fprintf(stderr, "Could not write the vocabulary to %s\n", dir);
+        return EXIT_FAILURE;
+    }
+    set_witness_to_file(false);
+    for (i = 0; i < num_atoms; i++) {
+        for (j = 0; j < num_depths; j++) {
+            run_grid_point(dir, atoms[i], depths[j], num_formulas, facts);
+        }
+    }
+    return EXIT_SUCCESS;
+}
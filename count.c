@@ -0,0 +1,1174 @@
+#include "count.h"
+#include "number.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+
+/* The counts of components are cached until they take COUNT_CACHE_MEMORY
+ * bytes, when the cache is emptied. */
+#define COUNT_CACHE_MEMORY (1 << 28)
+#define CACHE_MIN_BUCKETS  1024
+
+/* Components are branched along the places of their variables if at most
+ * one clause in this many crosses the middle. */
+#define COUNT_CROSSING_RATIO 8
+
+/* Components are counted by trying all assignments of their variables
+ * besides those defined by their clauses if their number of clauses times
+ * that of assignments is at most this. */
+#define COUNT_TABLE_WORK   (1 << 21)
+
+/* Failed literals are looked for among the variables of components of at
+ * most this many variables, as long as, past the first COUNT_PROBE_TRIALS
+ * components, at least one in COUNT_PROBE_RATIO of those probed had one. */
+#define COUNT_PROBE_VARS   64
+#define COUNT_PROBE_TRIALS 1024
+#define COUNT_PROBE_RATIO  4
+
+typedef struct cache_entry {
+    struct cache_entry* next;
+    unsigned hash;
+    int      key_size;
+    Number  count;
+    int      key[];     /* The variables, then the clauses, of a component. */
+} cache_entry;
+
+typedef struct counter {
+    bool    ok;            /* False once an empty clause was added. */
+    int     num_vars;
+    int     var_capacity;
+
+    /* Clause i is lits[clause_start[i]] .. lits[clause_start[i + 1] - 1],
+     * as internal literals. */
+    int*    lits;
+    int     num_lits;
+    int     lit_capacity;
+    int*    clause_start;
+    int     num_clauses;
+    int     clause_capacity;
+
+    /* The variable each clause is part of the definition of, or -1, and
+     * the variable that the clauses added now define. */
+    int*    defines;
+    int     define_capacity;
+    int     defining;
+
+    /* The clauses of each literal, occs[occ_start[lit]] onwards, made
+     * again when clauses were added. */
+    int*    occ_start;
+    int*    occs;
+    bool    occs_valid;
+
+    /* Per variable data. */
+    signed char* assigns;  /* 1 for true, -1 for false, 0 if unassigned, 2
+                            * if its definition is dropped. */
+    bool*   defined;       /* Whether clauses define it. */
+    int*    uses;          /* Clauses that need it besides its definition. */
+    int*    slot;          /* Its row in count_table(). */
+    unsigned* var_stamps;
+    int*    var_pos;       /* Its index in var_list. */
+    int*    scores;
+    int*    position;      /* In the order given to counter_set_order(), or -1. */
+    int*    place;         /* The position, or one given by place_unordered(). */
+
+    /* Per clause data. */
+    int*    num_true;      /* Literals of the clause that are true. */
+    unsigned* clause_stamps;
+    int*    clause_pos;    /* Its index in clause_list. */
+    unsigned  stamp;
+
+    /* All variables and clauses, in an order that puts those of each
+     * component being counted together. */
+    int*    var_list;
+    int*    clause_list;
+
+    int*    trail;
+    int     trail_size;
+    int     qhead;
+
+    cache_entry** buckets;
+    int     num_buckets;   /* A power of 2. */
+    int     num_entries;
+    size_t  cache_memory;
+
+    long long num_probed;  /* Components whose failed literals were looked for, */
+    long long num_failed;  /* and those that had some. */
+} counter;
+
+/* ==================== Helper Functions =====================*/
+
+static int lit_var(int lit) {
+    return lit >> 1;
+}
+
+static bool lit_sign(int lit) {
+    return (lit & 1) == 1;
+}
+
+static int from_dimacs(int lit) {
+    return lit > 0 ? 2 * (lit - 1) : 2 * (-lit - 1) + 1;
+}
+
+static int lit_value(Counter c, int lit) {
+    int value = c->assigns[lit_var(lit)];
+    return lit_sign(lit) ? -value : value;
+}
+
+static void* grow_array(void* array, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) {
+        return array;
+    }
+    int new_capacity = *capacity == 0 ? 16 : *capacity;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    *capacity = new_capacity;
+    return realloc(array, elem_size * new_capacity);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* ==================== Component Cache =====================*/
+
+/*
+ * Mix the bits of a variable or clause of a key. The hash of a key is the
+ * sum of those of its items, whatever their order.
+ */
+static unsigned hash_item(unsigned x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void cache_clear(Counter c) {
+    int i;
+    cache_entry* e;
+    cache_entry* next;
+    for (i = 0; i < c->num_buckets; i++) {
+        for (e = c->buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            number_free(e->count);
+            free(e);
+        }
+        c->buckets[i] = NULL;
+    }
+    c->num_entries = 0;
+    c->cache_memory = 0;
+}
+
+/*
+ * Return a copy of the count cached for the key, or NULL. Keys are sets:
+ * the variables and clauses of the key looked for are those whose stamps
+ * are the current stamp.
+ */
+static Number cache_find(Counter c, const int* key, int key_size, unsigned h) {
+    cache_entry* e;
+    int i;
+    for (e = c->buckets[h & (c->num_buckets - 1)]; e != NULL; e = e->next) {
+        if (e->hash != h || e->key_size != key_size || e->key[0] != key[0]) {
+            continue;
+        }
+        for (i = 1; i <= key[0] && c->var_stamps[e->key[i]] == c->stamp; i++) {
+        }
+        for (; i < key_size && c->clause_stamps[e->key[i]] == c->stamp; i++) {
+        }
+        if (i == key_size) {
+            return number_copy(e->count);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Cache the count of a component. It is below 2 to the power of its number
+ * of variables, so it takes no more room than the key.
+ */
+static void cache_add(Counter c, const int* key, int key_size, unsigned h, Number count) {
+    size_t size = sizeof(cache_entry) + 2 * sizeof(int) * (key_size + 1);
+    if (c->cache_memory + size > COUNT_CACHE_MEMORY) {
+        cache_clear(c);
+    }
+    if (c->num_entries >= c->num_buckets) {
+        int num_buckets = 2 * c->num_buckets;
+        cache_entry** buckets = calloc(num_buckets, sizeof(cache_entry*));
+        int i;
+        cache_entry* e;
+        cache_entry* next;
+        for (i = 0; i < c->num_buckets; i++) {
+            for (e = c->buckets[i]; e != NULL; e = next) {
+                next = e->next;
+                e->next = buckets[e->hash & (num_buckets - 1)];
+                buckets[e->hash & (num_buckets - 1)] = e;
+            }
+        }
+        free(c->buckets);
+        c->buckets = buckets;
+        c->num_buckets = num_buckets;
+    }
+    cache_entry* e = malloc(sizeof(cache_entry) + sizeof(int) * key_size);
+    e->hash = h;
+    e->key_size = key_size;
+    e->count = number_copy(count);
+    memcpy(e->key, key, sizeof(int) * key_size);
+    e->next = c->buckets[h & (c->num_buckets - 1)];
+    c->buckets[h & (c->num_buckets - 1)] = e;
+    c->num_entries++;
+    c->cache_memory += size;
+}
+
+/* ==================== Assignment Trail =====================*/
+
+/*
+ * List the clauses of each literal, once all clauses are known.
+ */
+static void make_occurrences(Counter c) {
+    if (c->occs_valid) {
+        return;
+    }
+    int num_lits = 2 * c->num_vars;
+    free(c->occ_start);
+    free(c->occs);
+    c->occ_start = calloc(num_lits + 1, sizeof(int));
+    c->occs = malloc(sizeof(int) * (c->num_lits + 1));
+    int i, k;
+    for (k = 0; k < c->num_lits; k++) {
+        c->occ_start[c->lits[k] + 1]++;
+    }
+    for (i = 0; i < num_lits; i++) {
+        c->occ_start[i + 1] += c->occ_start[i];
+    }
+    int* fill = malloc(sizeof(int) * (num_lits + 1));
+    memcpy(fill, c->occ_start, sizeof(int) * (num_lits + 1));
+    for (i = 0; i < c->num_clauses; i++) {
+        for (k = c->clause_start[i]; k < c->clause_start[i + 1]; k++) {
+            c->occs[fill[c->lits[k]]++] = i;
+        }
+    }
+    free(fill);
+    free(c->num_true);
+    free(c->clause_stamps);
+    free(c->clause_pos);
+    c->num_true = calloc(c->num_clauses + 1, sizeof(int));
+    c->clause_stamps = calloc(c->num_clauses + 1, sizeof(unsigned));
+    c->clause_pos = malloc(sizeof(int) * (c->num_clauses + 1));
+    c->occs_valid = true;
+}
+
+static void assign(Counter c, int lit) {
+    c->assigns[lit_var(lit)] = lit_sign(lit) ? -1 : 1;
+    c->trail[c->trail_size++] = lit;
+    int k;
+    for (k = c->occ_start[lit]; k < c->occ_start[lit + 1]; k++) {
+        c->num_true[c->occs[k]]++;
+    }
+}
+
+/*
+ * Take the definition of a variable as satisfied, whatever its value: its
+ * clauses count as true, and it as assigned. It is on the trail as its
+ * positive literal, which propagation skips.
+ */
+static void drop_definition(Counter c, int var) {
+    c->assigns[var] = 2;
+    c->trail[c->trail_size++] = 2 * var;
+    int k;
+    for (k = c->occ_start[2 * var]; k < c->occ_start[2 * var + 2]; k++) {
+        if (c->defines[c->occs[k]] == var) {
+            c->num_true[c->occs[k]]++;
+        }
+    }
+}
+
+static void undo_until(Counter c, int trail_size) {
+    while (c->trail_size > trail_size) {
+        int lit = c->trail[--c->trail_size];
+        int var = lit_var(lit);
+        int k;
+        if (c->assigns[var] == 2) {
+            for (k = c->occ_start[lit]; k < c->occ_start[lit + 2]; k++) {
+                if (c->defines[c->occs[k]] == var) {
+                    c->num_true[c->occs[k]]--;
+                }
+            }
+        }
+        else {
+            for (k = c->occ_start[lit]; k < c->occ_start[lit + 1]; k++) {
+                c->num_true[c->occs[k]]--;
+            }
+        }
+        c->assigns[var] = 0;
+    }
+    c->qhead = trail_size;
+}
+
+/*
+ * Assign the literals left alone in a clause by the assignments not yet
+ * propagated. Return false on a clause whose literals are all false.
+ */
+static bool propagate(Counter c) {
+    while (c->qhead < c->trail_size) {
+        int false_lit = c->trail[c->qhead++] ^ 1;
+        int k, j;
+        if (c->assigns[lit_var(false_lit)] == 2) {
+            continue;
+        }
+        for (k = c->occ_start[false_lit]; k < c->occ_start[false_lit + 1]; k++) {
+            int cl = c->occs[k];
+            if (c->num_true[cl] > 0) {
+                continue;
+            }
+            int unit = -1;
+            int num_free = 0;
+            for (j = c->clause_start[cl]; j < c->clause_start[cl + 1] && num_free < 2; j++) {
+                if (lit_value(c, c->lits[j]) == 0) {
+                    unit = c->lits[j];
+                    num_free++;
+                }
+            }
+            if (num_free == 0) {
+                return false;
+            }
+            if (num_free == 1) {
+                assign(c, unit);
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Assign the literals of the unit clauses, and propagate. Return false if
+ * the clauses turn out to be unsatisfiable.
+ */
+static bool start_search(Counter c) {
+    make_occurrences(c);
+    if (!c->ok) {
+        return false;
+    }
+    int i;
+    for (i = 0; i < c->num_clauses; i++) {
+        if (c->clause_start[i + 1] - c->clause_start[i] == 1) {
+            int lit = c->lits[c->clause_start[i]];
+            if (lit_value(c, lit) == -1) {
+                return false;
+            }
+            if (lit_value(c, lit) == 0) {
+                assign(c, lit);
+            }
+        }
+    }
+    return propagate(c);
+}
+
+/* ==================== Counting =====================*/
+
+static Number count_components(Counter c, int* vars, int num_vars, int* clauses);
+
+/*
+ * Place each variable left out of the order, such as those of connectives,
+ * among the variables it shares clauses with: going out from the ordered
+ * variables a layer at a time, each variable reached takes the mean place
+ * of its neighbours in the layers before. Branching on these variables
+ * splits components that no ordered variable splits by itself, such as
+ * chains of iff, where a connective joins all the atoms before it to all
+ * those after.
+ */
+static void place_unordered(Counter c) {
+    int* layer = malloc(sizeof(int) * (c->num_vars + 1));
+    int* next = malloc(sizeof(int) * (c->num_vars + 1));
+    long long* sums = calloc(c->num_vars + 1, sizeof(long long));
+    int* counts = calloc(c->num_vars + 1, sizeof(int));
+    int size = 0;
+    int i, k, j;
+    for (i = 0; i < c->num_vars; i++) {
+        c->place[i] = c->position[i];
+        if (c->place[i] >= 0) {
+            layer[size++] = i;
+        }
+    }
+    while (size > 0) {
+        int next_size = 0;
+        for (i = 0; i < size; i++) {
+            int v = layer[i];
+            for (k = c->occ_start[2 * v]; k < c->occ_start[2 * v + 2]; k++) {
+                int cl = c->occs[k];
+                for (j = c->clause_start[cl]; j < c->clause_start[cl + 1]; j++) {
+                    int w = lit_var(c->lits[j]);
+                    if (c->place[w] >= 0) {
+                        continue;
+                    }
+                    if (counts[w] == 0) {
+                        next[next_size++] = w;
+                    }
+                    sums[w] += c->place[v];
+                    counts[w]++;
+                }
+            }
+        }
+        for (i = 0; i < next_size; i++) {
+            c->place[next[i]] = (int)(sums[next[i]] / counts[next[i]]);
+        }
+        int* t = layer;
+        layer = next;
+        next = t;
+        size = next_size;
+    }
+    free(layer);
+    free(next);
+    free(sums);
+    free(counts);
+}
+
+/*
+ * Choose the variable of a component to branch on. If few of its clauses
+ * have variables placed on both sides of the middle of those placed, it
+ * is the variable placed in the middle, so that the variables before and
+ * those after soon fall into different components. Otherwise, the places
+ * do not tell where it splits, and it is the variable in most clauses,
+ * which settles the most of them, preferring those that no clause
+ * defines, which bring components down to count_table().
+ */
+static int choose_branch(Counter c, const int* vars, int num_vars,
+                         const int* clauses, int num_clauses) {
+    int* positions = malloc(sizeof(int) * (num_vars + 1));
+    int num_positions = 0;
+    int i, k;
+    for (i = 0; i < num_vars; i++) {
+        if (c->place[vars[i]] >= 0) {
+            positions[num_positions++] = c->place[vars[i]];
+        }
+    }
+    int middle = -1;
+    if (num_positions > 0) {
+        qsort(positions, num_positions, sizeof(int), compare_ints);
+        middle = positions[num_positions / 2];
+    }
+    free(positions);
+
+    int num_crossing = 0;
+    for (i = 0; i < num_clauses; i++) {
+        bool before = false;
+        bool after = false;
+        for (k = c->clause_start[clauses[i]]; k < c->clause_start[clauses[i] + 1]; k++) {
+            int v = lit_var(c->lits[k]);
+            c->scores[v]++;
+            if (c->assigns[v] == 0 && c->place[v] >= 0) {
+                before |= c->place[v] < middle;
+                after |= c->place[v] > middle;
+            }
+        }
+        num_crossing += before && after;
+    }
+    bool local = middle >= 0 && COUNT_CROSSING_RATIO * num_crossing <= num_clauses;
+    int best = -1;
+    int best_distance = 0;
+    for (i = 0; i < num_vars; i++) {
+        int v = vars[i];
+        int distance = c->place[v] < 0 ? INT_MAX : abs(c->place[v] - middle);
+        if (!local && best != -1 && c->defined[v] != c->defined[best]) {
+            if (c->defined[best]) {
+                best = v;
+                best_distance = distance;
+            }
+            continue;
+        }
+        if (best == -1 ||
+            (local ? distance < best_distance : c->scores[v] > c->scores[best]) ||
+            (local ? distance == best_distance && c->scores[v] > c->scores[best]
+                   : c->scores[v] == c->scores[best] && distance < best_distance)) {
+            best = v;
+            best_distance = distance;
+        }
+    }
+    for (i = 0; i < num_clauses; i++) {
+        for (k = c->clause_start[clauses[i]]; k < c->clause_start[clauses[i] + 1]; k++) {
+            c->scores[lit_var(c->lits[k])] = 0;
+        }
+    }
+    return best;
+}
+
+/*
+ * Drop the definitions of the variables that no other clause of a
+ * component needs any more, such as those of connectives below a conjunct
+ * already false: whatever the other variables, exactly one value of such a
+ * variable satisfies its definition, so the count is the same without it.
+ * Its own variables may then be needed only by definitions in turn. Return
+ * true if any definition was dropped.
+ */
+static bool drop_unused_definitions(Counter c, const int* vars, int num_vars,
+                                    const int* clauses, int num_clauses) {
+    int* queue = malloc(sizeof(int) * (num_vars + 1));
+    int size = 0;
+    int i, k, j;
+    for (i = 0; i < num_clauses; i++) {
+        int cl = clauses[i];
+        for (k = c->clause_start[cl]; k < c->clause_start[cl + 1]; k++) {
+            int v = lit_var(c->lits[k]);
+            if (c->assigns[v] == 0 && c->defines[cl] != v) {
+                c->uses[v]++;
+            }
+        }
+    }
+    for (i = 0; i < num_vars; i++) {
+        if (c->defined[vars[i]] && c->uses[vars[i]] == 0) {
+            queue[size++] = vars[i];
+        }
+    }
+    bool dropped = size > 0;
+    while (size > 0) {
+        int g = queue[--size];
+        for (k = c->occ_start[2 * g]; k < c->occ_start[2 * g + 2]; k++) {
+            int cl = c->occs[k];
+            if (c->defines[cl] != g || c->num_true[cl] > 0) {
+                continue;
+            }
+            for (j = c->clause_start[cl]; j < c->clause_start[cl + 1]; j++) {
+                int w = lit_var(c->lits[j]);
+                if (w != g && c->assigns[w] == 0 && --c->uses[w] == 0 && c->defined[w]) {
+                    queue[size++] = w;
+                }
+            }
+        }
+        drop_definition(c, g);
+    }
+    for (i = 0; i < num_vars; i++) {
+        c->uses[vars[i]] = 0;
+    }
+    free(queue);
+    return dropped;
+}
+
+/*
+ * Assign the opposite of each literal of a small component whose
+ * assignment propagates to a conflict, as it holds in every model. Return
+ * false if both literals of a variable fail, when there are none.
+ */
+static bool assign_failed_literals(Counter c, const int* vars, int num_vars) {
+    if (num_vars > COUNT_PROBE_VARS ||
+        (c->num_probed >= COUNT_PROBE_TRIALS &&
+         COUNT_PROBE_RATIO * c->num_failed < c->num_probed)) {
+        return true;
+    }
+    c->num_probed++;
+    int trail_start = c->trail_size;
+    int i, side;
+    for (i = 0; i < num_vars; i++) {
+        for (side = 0; side < 2 && c->assigns[vars[i]] == 0; side++) {
+            int trail_size = c->trail_size;
+            assign(c, 2 * vars[i] + side);
+            bool failed = !propagate(c);
+            undo_until(c, trail_size);
+            if (failed) {
+                assign(c, 2 * vars[i] + 1 - side);
+                if (!propagate(c)) {
+                    c->num_failed++;
+                    return false;
+                }
+            }
+        }
+    }
+    c->num_failed += c->trail_size > trail_start;
+    return true;
+}
+
+/*
+ * Append to the program of count_table() the number of literals of a
+ * clause not yet assigned, other than those of skip, then each of them as
+ * twice the row of its variable, plus one where the row is to be negated
+ * to give where the literal is true, or, if flip, where it is false.
+ * Return the new size of the program.
+ */
+static int add_table_clause(Counter c, int** code, int* capacity, int size,
+                            int cl, bool flip, int skip) {
+    *code = grow_array(*code, capacity, size + 1, sizeof(int));
+    int start = size++;
+    int k;
+    for (k = c->clause_start[cl]; k < c->clause_start[cl + 1]; k++) {
+        int v = lit_var(c->lits[k]);
+        if (v != skip && c->assigns[v] == 0) {
+            *code = grow_array(*code, capacity, size + 1, sizeof(int));
+            (*code)[size++] = 2 * c->slot[v] + (lit_sign(c->lits[k]) != flip);
+        }
+    }
+    (*code)[start] = size - start - 1;
+    return size;
+}
+
+/*
+ * Count the models of a component by trying all assignments of its
+ * variables that no clause defines, 64 at a time as bit patterns, as
+ * eval_slice() does for formulas. Each defined variable then takes the
+ * value its definition forces, in the order of the variables, as
+ * definitions only use variables defined before, and the models are the
+ * assignments that make the other clauses true. The clauses are first
+ * turned into a program over the rows of the variables: for each defined
+ * variable, the number of clauses of its definition with it positive and
+ * the other literals of each, which it is true where all are false; then
+ * the other clauses, all of which must have a true literal.
+ */
+static Number count_table(Counter c, const int* vars, int num_vars,
+                          const int* clauses, int num_clauses) {
+    static const uint64_t patterns[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    int* defined_vars = malloc(sizeof(int) * (num_vars + 1));
+    int num_free = 0;
+    int num_defined = 0;
+    int i, k;
+    for (i = 0; i < num_vars; i++) {
+        if (c->defined[vars[i]]) {
+            defined_vars[num_defined++] = vars[i];
+        }
+        else {
+            c->slot[vars[i]] = num_free++;
+        }
+    }
+    qsort(defined_vars, num_defined, sizeof(int), compare_ints);
+    for (i = 0; i < num_defined; i++) {
+        c->slot[defined_vars[i]] = num_free + i;
+    }
+
+    int* code = NULL;
+    int capacity = 0;
+    int size = 0;
+    for (i = 0; i < num_defined; i++) {
+        int g = defined_vars[i];
+        int start = size++;
+        code = grow_array(code, &capacity, size, sizeof(int));
+        for (k = c->occ_start[2 * g]; k < c->occ_start[2 * g + 1]; k++) {
+            int cl = c->occs[k];
+            if (c->defines[cl] == g && c->num_true[cl] == 0) {
+                size = add_table_clause(c, &code, &capacity, size, cl, true, g);
+            }
+        }
+        code[start] = 0;
+        for (k = start + 1; k < size; k += code[k] + 1) {
+            code[start]++;
+        }
+    }
+    for (i = 0; i < num_clauses; i++) {
+        int g = c->defines[clauses[i]];
+        if (g < 0 || c->assigns[g] != 0) {
+            size = add_table_clause(c, &code, &capacity, size, clauses[i], false, -1);
+        }
+    }
+    free(defined_vars);
+
+    /* Below 64 assignments, the patterns repeat. */
+    uint64_t mask = num_free < 6 ? ((uint64_t)1 << (1 << num_free)) - 1 : ~(uint64_t)0;
+    int num_words = num_free < 6 ? 1 : 1 << (num_free - 6);
+    uint64_t* rows = malloc(sizeof(uint64_t) * (num_vars + 1));
+    unsigned num_models = 0;
+    int w;
+    for (w = 0; w < num_words; w++) {
+        for (i = 0; i < num_free; i++) {
+            rows[i] = i < 6 ? patterns[i] : -(uint64_t)((w >> (i - 6)) & 1);
+        }
+        const int* p = code;
+        for (i = num_free; i < num_vars; i++) {
+            uint64_t value = 0;
+            int num_terms = *p++;
+            while (num_terms-- > 0) {
+                uint64_t forced = ~(uint64_t)0;
+                int num_lits = *p++;
+                while (num_lits-- > 0) {
+                    forced &= rows[*p >> 1] ^ -(uint64_t)(*p & 1);
+                    p++;
+                }
+                value |= forced;
+            }
+            rows[i] = value;
+        }
+        uint64_t models = mask;
+        while (p < code + size && models != 0) {
+            uint64_t satisfied = 0;
+            int num_lits = *p++;
+            while (num_lits-- > 0) {
+                satisfied |= rows[*p >> 1] ^ -(uint64_t)(*p & 1);
+                p++;
+            }
+            models &= satisfied;
+        }
+        num_models += __builtin_popcountll(models);
+    }
+    free(rows);
+    free(code);
+    return number_new(num_models);
+}
+
+/*
+ * Make the key under which the count of a component is cached, given its
+ * unassigned variables and the clauses not yet satisfied that join them,
+ * and its hash. Within a component, the literals of a clause not yet
+ * assigned are those of its variables, and a clause none of whose literals
+ * is assigned is one all of whose variables are in it: the variables, and
+ * the clauses with a literal assigned, tell the clauses left exactly. They
+ * are stamped, for cache_find() to compare keys as sets.
+ */
+static int* make_key(Counter c, const int* vars, int num_vars, const int* clauses,
+                     int num_clauses, int* key_size, unsigned* hash) {
+    int* key = malloc(sizeof(int) * (num_vars + num_clauses + 1));
+    unsigned stamp = ++c->stamp;
+    unsigned h = num_vars;
+    int i, k;
+    key[0] = num_vars;
+    for (i = 0; i < num_vars; i++) {
+        key[i + 1] = vars[i];
+        c->var_stamps[vars[i]] = stamp;
+        h += hash_item(2 * vars[i]);
+    }
+    int size = 1 + num_vars;
+    for (i = 0; i < num_clauses; i++) {
+        int cl = clauses[i];
+        for (k = c->clause_start[cl]; k < c->clause_start[cl + 1]; k++) {
+            if (c->assigns[lit_var(c->lits[k])] != 0) {
+                key[size++] = cl;
+                c->clause_stamps[cl] = stamp;
+                h += hash_item(2 * cl + 1);
+                break;
+            }
+        }
+    }
+    *key_size = size;
+    *hash = h;
+    return key;
+}
+
+/*
+ * Count the models of a component, given by its unassigned variables and
+ * the clauses not yet satisfied that join them. Those with few clauses and
+ * few variables besides defined ones go to count_table(). Otherwise,
+ * definitions no longer needed are dropped and failed literals assigned,
+ * which may split it further, or else it is branched on the variable
+ * choose_branch() picks. The lists may be reordered; the caller's
+ * assignment is kept. The key is made again to be cached, rather than
+ * kept while counting, so that the memory taken does not grow with the
+ * depth of the search.
+ */
+static Number count_component(Counter c, int* vars, int num_vars,
+                              int* clauses, int num_clauses) {
+    int key_size;
+    unsigned h;
+    int* key = make_key(c, vars, num_vars, clauses, num_clauses, &key_size, &h);
+    Number count = cache_find(c, key, key_size, h);
+    free(key);
+    if (count != NULL) {
+        return count;
+    }
+
+    int num_free = 0;
+    int i;
+    for (i = 0; i < num_vars; i++) {
+        num_free += !c->defined[vars[i]];
+    }
+    int trail_size = c->trail_size;
+    if (num_free < 32 && ((size_t)num_clauses << num_free) <= COUNT_TABLE_WORK) {
+        count = count_table(c, vars, num_vars, clauses, num_clauses);
+    }
+    else if (drop_unused_definitions(c, vars, num_vars, clauses, num_clauses)) {
+        count = count_components(c, vars, num_vars, clauses);
+    }
+    else if (!assign_failed_literals(c, vars, num_vars)) {
+        count = number_new(0);
+    }
+    else if (c->trail_size > trail_size) {
+        count = count_components(c, vars, num_vars, clauses);
+    }
+    else {
+        int best = choose_branch(c, vars, num_vars, clauses, num_clauses);
+        count = number_new(0);
+        int side;
+        for (side = 0; side < 2; side++) {
+            assign(c, 2 * best + side);
+            if (propagate(c)) {
+                Number branch = count_components(c, vars, num_vars, clauses);
+                Number sum = number_add(count, branch);
+                number_free(count);
+                number_free(branch);
+                count = sum;
+            }
+            undo_until(c, trail_size);
+        }
+    }
+    undo_until(c, trail_size);
+    key = make_key(c, vars, num_vars, clauses, num_clauses, &key_size, &h);
+    cache_add(c, key, key_size, h, count);
+    free(key);
+    return count;
+}
+
+/*
+ * Swap the variables or clauses at indexes i and j of a list, keeping pos,
+ * the index of each, up to date.
+ */
+static void swap_items(int* list, int* pos, int i, int j) {
+    int x = list[i];
+    list[i] = list[j];
+    list[j] = x;
+    pos[list[i]] = i;
+    pos[list[j]] = j;
+}
+
+/*
+ * Count the models of the clauses not yet satisfied over the variables of
+ * a list that are not assigned, by splitting them into components joined
+ * by those clauses, each counted as soon as it is found. The list is that
+ * of a component being counted, and its clauses, those of the component,
+ * which hold all such clauses. The lists of all components are parts of
+ * the lists of all variables and clauses, so splitting takes no memory:
+ * the variables and clauses of each component found are moved to the
+ * front of what is left of those of the lists. A variable in no clause is
+ * a component that doubles the count.
+ */
+static Number count_components(Counter c, int* vars, int num_vars, int* clauses) {
+    Number count = number_new(1);
+    int var_end = (int)(vars - c->var_list);
+    int clause_end = (int)(clauses - c->clause_list);
+    int last = var_end + num_vars;
+    int i, k, j;
+    for (i = var_end; i < last && !number_is_zero(count); i++) {
+        if (i < var_end || c->assigns[c->var_list[i]] != 0) {
+            continue;
+        }
+        int first_var = var_end;
+        int first_clause = clause_end;
+        unsigned stamp = ++c->stamp;
+        c->var_stamps[c->var_list[i]] = stamp;
+        swap_items(c->var_list, c->var_pos, i, var_end++);
+        int next;
+        for (next = first_var; next < var_end; next++) {
+            int u = c->var_list[next];
+            for (k = c->occ_start[2 * u]; k < c->occ_start[2 * u + 2]; k++) {
+                int cl = c->occs[k];
+                if (c->num_true[cl] > 0 || c->clause_stamps[cl] == stamp) {
+                    continue;
+                }
+                c->clause_stamps[cl] = stamp;
+                swap_items(c->clause_list, c->clause_pos, c->clause_pos[cl], clause_end++);
+                for (j = c->clause_start[cl]; j < c->clause_start[cl + 1]; j++) {
+                    int w = lit_var(c->lits[j]);
+                    if (c->assigns[w] == 0 && c->var_stamps[w] != stamp) {
+                        c->var_stamps[w] = stamp;
+                        swap_items(c->var_list, c->var_pos, c->var_pos[w], var_end++);
+                    }
+                }
+            }
+        }
+        Number part = clause_end == first_clause ? number_new(2) :
+                      count_component(c, c->var_list + first_var, var_end - first_var,
+                                      c->clause_list + first_clause, clause_end - first_clause);
+        Number product = number_mul(count, part);
+        number_free(count);
+        number_free(part);
+        count = product;
+    }
+    return count;
+}
+
+/* ==================== Enumeration =====================*/
+
+/*
+ * Tell whether the assignment extends to a model, by a plain search on
+ * the variables of the clauses not yet satisfied.
+ */
+static bool extend(Counter c) {
+    if (c->trail_size == c->num_vars) {
+        return true;
+    }
+    int lit = -1;
+    int i, k;
+    for (i = 0; i < c->num_clauses && lit == -1; i++) {
+        if (c->num_true[i] > 0) {
+            continue;
+        }
+        for (k = c->clause_start[i]; k < c->clause_start[i + 1]; k++) {
+            if (lit_value(c, c->lits[k]) == 0) {
+                lit = c->lits[k];
+                break;
+            }
+        }
+    }
+    if (lit == -1) {
+        return true;
+    }
+    int trail_size = c->trail_size;
+    int side;
+    for (side = 0; side < 2; side++) {
+        assign(c, side == 0 ? lit : lit ^ 1);
+        bool found = propagate(c) && extend(c);
+        undo_until(c, trail_size);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ==================== Functions Implemented =====================*/
+
+Counter counter_new(void) {
+    Counter c = calloc(1, sizeof(counter));
+    c->ok = true;
+    c->num_buckets = CACHE_MIN_BUCKETS;
+    c->buckets = calloc(c->num_buckets, sizeof(cache_entry*));
+    c->clause_start = malloc(sizeof(int));
+    c->clause_start[0] = 0;
+    c->clause_capacity = 1;
+    c->defining = -1;
+    return c;
+}
+
+void counter_free(Counter c) {
+    cache_clear(c);
+    free(c->buckets);
+    free(c->lits);
+    free(c->clause_start);
+    free(c->defines);
+    free(c->occ_start);
+    free(c->occs);
+    free(c->assigns);
+    free(c->defined);
+    free(c->uses);
+    free(c->slot);
+    free(c->var_stamps);
+    free(c->var_pos);
+    free(c->scores);
+    free(c->position);
+    free(c->place);
+    free(c->num_true);
+    free(c->clause_stamps);
+    free(c->clause_pos);
+    free(c->trail);
+    free(c);
+}
+
+int counter_new_var(Counter c) {
+    int v = c->num_vars;
+    if (v == c->var_capacity) {
+        int capacity = c->var_capacity == 0 ? 64 : 2 * c->var_capacity;
+        c->assigns    = realloc(c->assigns, sizeof(signed char) * capacity);
+        c->defined    = realloc(c->defined, sizeof(bool) * capacity);
+        c->uses       = realloc(c->uses, sizeof(int) * capacity);
+        c->slot       = realloc(c->slot, sizeof(int) * capacity);
+        c->var_stamps = realloc(c->var_stamps, sizeof(unsigned) * capacity);
+        c->var_pos    = realloc(c->var_pos, sizeof(int) * capacity);
+        c->scores     = realloc(c->scores, sizeof(int) * capacity);
+        c->position   = realloc(c->position, sizeof(int) * capacity);
+        c->place      = realloc(c->place, sizeof(int) * capacity);
+        c->trail      = realloc(c->trail, sizeof(int) * capacity);
+        c->var_capacity = capacity;
+    }
+    c->num_vars++;
+    c->assigns[v] = 0;
+    c->defined[v] = false;
+    c->uses[v] = 0;
+    c->var_stamps[v] = 0;
+    c->scores[v] = 0;
+    c->position[v] = -1;
+    c->place[v] = -1;
+    c->occs_valid = false;
+    return v + 1;
+}
+
+/*
+ * Give an order to variables, listed as DIMACS variables, that puts those
+ * occurring together close to one another. The count branches along the
+ * order, splitting the clauses, with the other variables placed among the
+ * ordered ones they share clauses with.
+ */
+void counter_set_order(Counter c, const int* vars, int num_vars) {
+    int i;
+    for (i = 0; i < num_vars; i++) {
+        while (c->num_vars < vars[i]) {
+            counter_new_var(c);
+        }
+        c->position[vars[i] - 1] = i;
+    }
+}
+
+/*
+ * Tell that the clauses added from now on, until the next call, define a
+ * DIMACS variable: whatever the values of their other variables, which
+ * are not defined or were defined before it, exactly one value of it
+ * satisfies them all. 0 ends the definitions. The count drops those of
+ * variables that no other clause needs, and finds the values of defined
+ * variables from those of the others.
+ */
+void counter_define(Counter c, int var) {
+    c->defining = var - 1;
+    if (var > 0) {
+        while (c->num_vars < var) {
+            counter_new_var(c);
+        }
+        c->defined[var - 1] = true;
+    }
+}
+
+/*
+ * Add a clause, given as DIMACS literals. Variables that do not exist yet
+ * are created. Return false if the clause is empty, when there are no
+ * models.
+ */
+bool counter_add_clause(Counter c, const int* lits, int num_lits) {
+    int start = c->num_lits;
+    int i, j;
+    c->lits = grow_array(c->lits, &c->lit_capacity, start + num_lits, sizeof(int));
+    for (i = 0; i < num_lits; i++) {
+        int var = lits[i] > 0 ? lits[i] : -lits[i];
+        while (c->num_vars < var) {
+            counter_new_var(c);
+        }
+        int lit = from_dimacs(lits[i]);
+
+        /* Drop repeated literals, and clauses that are always true. */
+        bool duplicate = false;
+        for (j = start; j < c->num_lits; j++) {
+            if (c->lits[j] == (lit ^ 1)) {
+                c->num_lits = start;
+                return true;
+            }
+            if (c->lits[j] == lit) {
+                duplicate = true;
+            }
+        }
+        if (!duplicate) {
+            c->lits[c->num_lits++] = lit;
+        }
+    }
+    if (c->num_lits == start) {
+        c->ok = false;
+        return false;
+    }
+    c->clause_start = grow_array(c->clause_start, &c->clause_capacity,
+                                 c->num_clauses + 2, sizeof(int));
+    c->defines = grow_array(c->defines, &c->define_capacity, c->num_clauses + 1, sizeof(int));
+    c->defines[c->num_clauses] = c->defining;
+    c->clause_start[++c->num_clauses] = c->num_lits;
+    c->occs_valid = false;
+    return true;
+}
+
+/*
+ * Return the number of models of the clauses added so far, in decimal,
+ * to be freed by the caller.
+ */
+char* counter_count(Counter c) {
+    Number count;
+    c->num_probed = 0;
+    c->num_failed = 0;
+    if (!start_search(c)) {
+        count = number_new(0);
+    }
+    else {
+        c->var_list = malloc(sizeof(int) * (c->num_vars + 1));
+        c->clause_list = malloc(sizeof(int) * (c->num_clauses + 1));
+        int i;
+        for (i = 0; i < c->num_vars; i++) {
+            c->var_list[i] = i;
+            c->var_pos[i] = i;
+        }
+        for (i = 0; i < c->num_clauses; i++) {
+            c->clause_list[i] = i;
+            c->clause_pos[i] = i;
+        }
+        place_unordered(c);
+        count = count_components(c, c->var_list, c->num_vars, c->clause_list);
+        free(c->var_list);
+        free(c->clause_list);
+        c->var_list = NULL;
+        c->clause_list = NULL;
+    }
+    undo_until(c, 0);
+    cache_clear(c);
+    char* digits = number_string(count);
+    number_free(count);
+    return digits;
+}
+
+/*
+ * Call report with the values of the variables 1 .. num_projected in each
+ * model of the clauses added so far, once for each assignment of them that
+ * extends to a model, until it returns false. The assignments come in
+ * order, as binary numbers whose most significant digit is variable 1,
+ * false being 0. Return the number of calls.
+ */
+long long counter_enumerate(Counter c, int num_projected,
+                            bool (*report)(const bool*, void*), void* data) {
+    while (c->num_vars < num_projected) {
+        counter_new_var(c);
+    }
+    long long num_models = 0;
+    if (!start_search(c)) {
+        undo_until(c, 0);
+        return 0;
+    }
+    bool* values = malloc(sizeof(bool) * (num_projected + 1));
+    int* decisions = malloc(sizeof(int) * (num_projected + 1));
+    int* trail_sizes = malloc(sizeof(int) * (num_projected + 1));
+    int num_decisions = 0;
+    int next = 0;
+    bool stop = false;
+    while (!stop) {
+        /* Decide the next variable not yet assigned, false first; once all
+         * are, report them if the other variables can follow. */
+        while (next < num_projected && c->assigns[next] != 0) {
+            next++;
+        }
+        bool conflict = false;
+        if (next < num_projected) {
+            decisions[num_decisions] = 2 * next + 1;
+            trail_sizes[num_decisions++] = c->trail_size;
+            assign(c, 2 * next + 1);
+            conflict = !propagate(c);
+        }
+        else {
+            conflict = true;
+            if (extend(c)) {
+                int i;
+                for (i = 0; i < num_projected; i++) {
+                    values[i] = c->assigns[i] == 1;
+                }
+                num_models++;
+                stop = !report(values, data);
+            }
+        }
+        if (!conflict) {
+            continue;
+        }
+
+        /* Go back to the last decision of a variable as false, and make
+         * it true instead. */
+        while (!stop) {
+            while (num_decisions > 0 && !lit_sign(decisions[num_decisions - 1])) {
+                num_decisions--;
+            }
+            if (num_decisions == 0) {
+                stop = true;
+                break;
+            }
+            int lit = decisions[num_decisions - 1] ^ 1;
+            undo_until(c, trail_sizes[num_decisions - 1]);
+            decisions[num_decisions - 1] = lit;
+            assign(c, lit);
+            next = lit_var(lit) + 1;
+            if (propagate(c)) {
+                break;
+            }
+        }
+    }
+    undo_until(c, 0);
+    free(values);
+    free(decisions);
+    free(trail_sizes);
+    return num_models;
+}
@@ -0,0 +1,33 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+#include <stdbool.h>
+
+/*
+ * A model counter for clauses.
+ *
+ * Variables and literals are numbered as for the solver of sat.h. The
+ * models counted are the assignments of all the variables that satisfy
+ * every clause, including the variables that occur in none. The count is
+ * exact, by a search that splits the clauses left into independent
+ * components and caches the count of each. Variables can be told to be
+ * defined by their clauses, as those of connectives are, so that their
+ * definitions are dropped once nothing else needs them, and components
+ * with few other variables are counted by trying all their assignments.
+ *
+ * Models can also be listed one at a time, as values of the first
+ * variables only, without keeping those already listed: memory does not
+ * grow with their number.
+ */
+typedef struct counter *Counter;
+
+Counter counter_new(void);
+void counter_free(Counter);
+int counter_new_var(Counter);
+void counter_set_order(Counter, const int *, int);
+void counter_define(Counter, int);
+bool counter_add_clause(Counter, const int *, int);
+char *counter_count(Counter);
+long long counter_enumerate(Counter, int, bool (*)(const bool *, void *), void *);
+
+#endif
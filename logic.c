@@ -1,33 +1,478 @@
+/* For madvise(), ftello() and fileno() under plain C99. */
+#define _DEFAULT_SOURCE
+
 #include "logic.h"
+#include "sat.h"
+#include "bdd.h"
+#include "count.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define BUFF_SIZE 2048
 
+/* Formulas that are not in a regular file are read this many bytes at a time. */
+#define CHUNK_SIZE 65536
+
+/* Formulas are allocated from blocks of at least this many bytes. */
+#define ARENA_BLOCK_SIZE 4096
+
+/*
+ * Formulas with at most this many atoms are decided by evaluating them on
+ * every assignment, SLICE_WORDS * 64 assignments at a time.
+ */
+#define TABLE_MAX_ATOMS 20
+#define SLICE_WORDS     8
+#define SLICE_BITS      9    /* SLICE_WORDS * 64 == 1 << SLICE_BITS */
+
+/* The BDD engine gives up, and leaves the formula to the search, beyond
+ * this many nodes. */
+#define BDD_MAX_NODES   (1 << 22)
+
+/* To decide satisfiability, where the search is the fallback, it gives up
+ * sooner: beyond this many nodes for each instruction of the program,
+ * though never below BDD_MIN_NODES, as building a node costs about as much
+ * as the search spends on an instruction. */
+#define BDD_NODES_PER_OP 16
+#define BDD_MIN_NODES   (1 << 16)
+
+/* With the engine left to choose, models are counted by a BDD of at most
+ * this many nodes if there is one, and by the counter otherwise. */
+#define COUNT_BDD_NODES (1 << 18)
+
+/* The order of the atoms of a conjunction is improved at most this many
+ * times. */
+#define BDD_ORDER_ROUNDS 32
+
+/* The clauses of popped groups and past queries of a knowledge base are
+ * deleted once they have more connectives than the formulas in force, and
+ * at least KB_MIN_RETIRED. */
+#define KB_MIN_RETIRED  1024
+
+/* Formulas are evaluated on worlds this many words (of 64 worlds) at a time. */
+#define COLUMN_BLOCK    64
+#define COLUMN_MEMORY   (1 << 22)
+
+/*
+ * Where the compiler supports it, the bit-sliced evaluator is built for
+ * several instruction sets and the widest one is picked when loading.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+/*
+ * Built with -DREASON_STATS, the time spent in each phase and the number
+ * of tokens, nodes, lookups and assignments are counted, to be reported by
+ * print_stats(). Otherwise all of this compiles to nothing. STAT_ADD is
+ * for the main thread, STAT_ADD_SHARED for the workers of the search.
+ */
+#ifdef REASON_STATS
+#define STAT_ADD(counter, n)        (stats.counter += (n))
+#define STAT_ADD_SHARED(counter, n) __atomic_fetch_add(&stats.counter, (n), __ATOMIC_RELAXED)
+#define STAT_START(phase)           uint64_t phase##_start = stat_clock()
+#define STAT_STOP(phase)            stat_stop(phase, phase##_start)
+#else
+#define STAT_ADD(counter, n)
+#define STAT_ADD_SHARED(counter, n)
+#define STAT_START(phase)
+#define STAT_STOP(phase)
+#endif
+
 typedef struct {
     char* name;
     int  arity;
 } PREDICATE;
 
+/*
+ * A table of interned strings. All strings are kept, each terminated by
+ * '\0', in one arena, and are found through an open addressing hash table
+ * of string indexes that stores the hash of each string.
+ */
+typedef struct {
+    char*     arena;
+    int       arena_size;
+    int       arena_capacity;
+    int*      offsets;        /* Offset of each string in the arena. */
+    unsigned* hashes;         /* Hash of each string. */
+    int       num_strings;
+    int       capacity;       /* Space allocated for offsets and hashes. */
+    int*      slots;          /* String indexes, -1 for empty slots. */
+    int       num_slots;      /* A power of 2. */
+} SYMBOL_TABLE;
+
+/*
+ * A ground atom: a predicate applied to names. The names are stored in
+ * atom_args, starting at first_arg.
+ */
+typedef struct {
+    int      predicate;
+    int      first_arg;
+    unsigned hash;
+} ATOM;
+
+/* Opcodes of compiled formulas. */
+enum {
+    OP_ATOM,       /* Push the value of the atom given as operand. */
+    OP_NOT,        /* Negate the top of the stack. */
+    OP_AND,        /* Pop two values and push their combination. */
+    OP_OR,
+    OP_IMPLIES,
+    OP_IFF,
+    OP_STORE,      /* Keep the top of the stack in the slot given as operand. */
+    OP_LOAD        /* Push the value kept in the slot given as operand. */
+};
+
+/*
+ * A formula compiled to postfix code: ops[i] is a 1-byte opcode and
+ * operands[i] the atom ID for OP_ATOM, or a slot for OP_STORE and OP_LOAD.
+ * A subformula shared by several parents is computed once and stored in a
+ * slot, then loaded. max_depth is the size of the stack needed to run the
+ * code, num_slots the number of values kept.
+ */
+typedef struct {
+    uint8_t* ops;
+    int32_t* operands;
+    int      size;
+    int      max_depth;
+    int      num_slots;
+} PROGRAM;
+
+/*
+ * Memory handed out in order from a list of blocks, and only given back
+ * all at once. Each block is at least twice as large as the previous one.
+ */
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+    char   data[];
+} ARENA_BLOCK;
+
+typedef struct {
+    ARENA_BLOCK* blocks;     /* Most recent block first. */
+} ARENA;
+
+/*
+ * A formula laid out to be evaluated in one interpretation at a time,
+ * evaluating a subformula only when it can change the result. Node i has
+ * opcode ops[i] and subformulas subs[2 * i] and subs[2 * i + 1], or the
+ * atom ID in subs[2 * i] for a leaf; nodes come after their subformulas,
+ * and the root is last. first[i] is the subformula that is evaluated
+ * first. Values are kept for the evaluation numbered stamp, so that shared
+ * nodes are evaluated once, and how often each node was false and true is
+ * counted, to order operands by reorder_formula().
+ */
+typedef struct {
+    int       num_nodes;
+    uint8_t*  ops;
+    int32_t*  subs;
+    uint8_t*  first;
+    uint32_t* cost;          /* Size of the subformula, counting shared nodes each time. */
+    uint32_t* counts;        /* counts[2 * i + v]: times node i was v. */
+    uint32_t* stamps;        /* Evaluation that values[i] belongs to. */
+    bool*     values;
+    uint32_t  stamp;
+    int32_t*  stack;
+} PLAN;
+
+/*
+ * A node of a formula. Structurally identical subformulas are the same
+ * node, so a formula is a DAG whose nodes are numbered from 0 by id,
+ * subformulas first.
+ */
 typedef struct formula {
     int  arity;
-    char* word;
+    const char* word;
+    int  atom;     /* ID of the atom for a leaf, -1 until it is resolved. */
     struct formula* sub_f1;
     struct formula* sub_f2;
+    int  id;
+    int  refs;     /* Number of parents. */
+    int  slot;     /* Where the value is kept when compiled, or -1. */
+    bool checked;  /* Known to be syntactically correct. */
+    PROGRAM* program;  /* Compiled code, made on first use from the root. */
+    PLAN*  plan;       /* Root only: made on first use by is_true(). */
+    ARENA* arena;      /* Root only: where the formula is allocated. */
+    void*  mapping;    /* Root only: the file a loaded formula's code is in. */
+    size_t mapping_size;
 } formula;
 
+/*
+ * The nodes of the formula being parsed, by word and subformulas.
+ */
+typedef struct {
+    ARENA*   arena;
+    Formula* slots;          /* Open addressing, NULL for empty slots. */
+    int      num_slots;      /* A power of 2. */
+    int      num_nodes;
+} NODE_TABLE;
+
+/*
+ * The set of true atoms, as a bitset indexed by atom ID. Atoms whose ID
+ * is at least num_atoms were interned later and are false.
+ */
 typedef struct interpretation {
-    int    num_atoms;
-    char** atoms;
+    int       num_atoms;
+    uint64_t* truth;
 } interpretation;
 
+/*
+ * The atoms of a formula, in order of first occurrence. index maps an
+ * atom ID to its position in atoms, or -1.
+ */
 typedef struct assumption {
-    char** atoms;
-    int    num_atoms;
-    int    truth;
+    int* atoms;
+    int  num_atoms;
+    int* index;
 } assumption;
 
+/*
+ * Several interpretations, or worlds, stored as a bit matrix with a row per
+ * atom: bit w of row a tells whether atom a is true in world w.
+ */
+typedef struct worlds {
+    int num_worlds;
+    int num_words;        /* Words per row. */
+    int num_atoms;        /* Number of rows. */
+    uint64_t* rows;
+} worlds;
+
+/*
+ * The value of every node of a formula in an interpretation, kept up to
+ * date as facts are added and retracted. Nodes are indexed by id, so the
+ * subformulas of a node come before it. As nodes are shared, each atom of
+ * the formula is a single leaf.
+ */
+typedef struct evaluation {
+    Formula        formula;
+    Interpretation interp;
+    int            num_nodes;
+    Formula*       nodes;          /* NULL for ids that are not in the formula. */
+    uint8_t*       ops;
+    bool*          values;
+    int*           first_parent;   /* The parents of node i are parents[first_parent[i]] */
+    int*           parents;        /* to parents[first_parent[i + 1] - 1]. */
+    int            num_atoms;      /* Size of leaves. */
+    int*           leaves;         /* Leaf of each atom ID, or -1. */
+    int*           heap;           /* Nodes to evaluate again, lowest id first. */
+    int            heap_size;
+    bool*          queued;
+} evaluation;
+
+/*
+ * A group of formulas of a knowledge base, taken back all at once.
+ */
+typedef struct {
+    int guard;        /* Variable that queries assume true. */
+    int first_used;   /* Where the atoms of its formulas start in used. */
+    int num_live;     /* num_live of the knowledge base when it was pushed. */
+} GROUP;
+
+/*
+ * A knowledge base: formulas kept as clauses in a solver, which keeps what
+ * it learns from one query to the next. The clauses of each open group of
+ * formulas are guarded by a variable that queries assume true, and that is
+ * made false when the group is popped; those of a query are guarded the
+ * same way for that query only. Atoms get a variable when first met:
+ * ass.index[atom] + 1.
+ */
+typedef struct knowledge_base {
+    Solver     solver;
+    assumption ass;
+    int        atom_capacity;  /* Size of ass.atoms and ass.index. */
+    int*       uses;           /* Formulas in force that each atom is in. */
+    int*       used;           /* The atoms of each formula in force, */
+    int        num_used;       /* those of each group after those of the */
+    int        used_capacity;  /* groups before, base formulas first. */
+    GROUP*     groups;         /* The open groups, the last pushed last. */
+    int        num_groups;
+    int        group_capacity;
+    int        num_live;       /* Connectives of the formulas in force, */
+    int        num_retired;    /* and of popped groups and past queries. */
+} knowledge_base;
+
+/*
+ * An assumption made while minimising a witness: either the negation of an
+ * atom, or the negation of an output of a totalizer, that is a bound on the
+ * number of atoms of a core that are true.
+ */
+typedef struct {
+    int  lit;
+    int* outputs;     /* Totalizer the bound belongs to, or NULL. */
+    int  bound;       /* lit is -outputs[bound]. */
+    int  size;        /* Number of outputs of the totalizer. */
+} SOFT;
+
+/*
+ * Where the clauses of a formula go: to the solver, or to the model counter
+ * if there is one. A guard that is not 0 is added to every clause, so that
+ * they only hold while it is false.
+ */
+typedef struct {
+    Solver  solver;
+    Counter counter;
+    int     guard;
+} CLAUSES;
+
+/*
+ * Where the models of a formula are written, and the atoms they are over.
+ */
+typedef struct {
+    FILE*       file;
+    assumption* ass;
+} MODEL_WRITER;
+
+/*
+ * A tokenizer reading formulas from a file, each ended by the delimiter or
+ * the end of the file. A regular file is mapped in memory; anything else is
+ * read a chunk at a time, keeping only the current token. A token is a
+ * slice of data, valid until the next one is read.
+ */
+typedef struct {
+    FILE*       file;
+    int         delimiter;
+    char*       data;
+    size_t      size;         /* Number of bytes in data. */
+    size_t      capacity;
+    size_t      pos;          /* Next byte to look at. */
+    bool        mapped;
+    bool        eof;          /* Nothing more to read from the file. */
+    bool        pending;      /* The current token is to be read again. */
+    const char* token;
+    int         token_len;    /* 0 at the end of a formula. */
+    size_t      dropped;      /* Bytes read and dropped before data. */
+    size_t      record_start; /* Offset in the file of the current formula. */
+} TOKENIZER;
+
+/*
+ * Why the last formula parsed is not a formula, and the offset of the
+ * first byte that is wrong, from the start of the formula. The reason is
+ * NULL if it is a formula.
+ */
+typedef struct {
+    long        offset;
+    const char* reason;
+} PARSE_ERROR;
+
+/*
+ * The whole contents of a file: mapped in memory for a regular file, read
+ * into a buffer otherwise.
+ */
+typedef struct {
+    char*  data;
+    size_t size;
+    bool   mapped;
+    void*  mapping;        /* The whole file, when mapped, from offset 0. */
+    size_t mapping_size;
+} FILE_VIEW;
+
+/*
+ * The header of a file holding a compiled formula. It is followed by the
+ * atoms of the formula, each a predicate and the position of its first
+ * name, by the names of the atoms, as int32_t, then by the operands and
+ * the opcodes of the code. Operands of OP_ATOM are positions in the list
+ * of atoms, replaced by atom IDs when the file is loaded.
+ */
+#define FORMULA_MAGIC   "RFML"
+#define FORMULA_VERSION 1
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint64_t fingerprint;     /* Of the names and predicates it was made with. */
+    uint32_t num_atoms;
+    uint32_t num_args;
+    uint32_t size;
+    uint32_t max_depth;
+    uint32_t num_slots;
+    uint32_t reserved;
+} FORMULA_FILE;
+
+/* The range of slices of a sweep level that a worker has yet to evaluate. */
+typedef struct {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+} WORK_RANGE;
+
+/*
+ * A level of the table search shared by its workers: the slices with the
+ * same number of true high atoms, and the best assignment found so far.
+ */
+typedef struct {
+    PROGRAM*     program;
+    assumption*  ass;
+    uint64_t     total;        /* Number of assignments. */
+    uint64_t*    slices;       /* High atoms of the slices of the level. */
+    int          num_slices;
+    int          level;        /* Number of true high atoms. */
+    WORK_RANGE*  ranges;       /* One per worker. */
+    int          num_workers;
+    pthread_mutex_t best_lock;
+    uint64_t     best;
+    int          best_count;   /* -1 until an assignment is found. */
+} SWEEP;
+
+typedef struct {
+    SWEEP* sweep;
+    int    id;
+} WORKER;
+
+/* Phases timed when statistics are on. */
+enum {
+    PHASE_LOAD,        /* Reading names, predicates, facts and worlds. */
+    PHASE_PARSE,       /* Tokenizing, parsing and checking formulas. */
+    PHASE_COMPILE,     /* Compiling formulas to postfix code. */
+    PHASE_EVAL,        /* Running the code in interpretations or worlds. */
+    PHASE_SEARCH,      /* Searching for a witness in is_satisfiable(). */
+    NUM_PHASES
+};
+
+typedef struct {
+    uint64_t phase_ns[NUM_PHASES];
+    uint64_t phase_calls[NUM_PHASES];
+    uint64_t tokens;
+    uint64_t nodes;               /* Nodes made, not counting shared ones. */
+    uint64_t symbol_lookups;      /* Names and predicates looked up. */
+    uint64_t fact_lookups;        /* Atoms read from an interpretation, or
+                                     from 64 worlds. */
+    uint64_t assignments;         /* Assignments evaluated by the table. */
+    uint64_t solver_calls;
+    uint64_t witness_candidates;  /* Satisfying assignments met. */
+} STATS;
+
+/* Number of threads of the table search, 0 for one per core. */
+int num_threads = 0;
+
+/*
+ * How satisfiability is decided: by the table for few atoms and by the
+ * solver otherwise, always by the solver, or by a BDD.
+ */
+enum { ENGINE_AUTO, ENGINE_SAT, ENGINE_BDD };
+int engine = ENGINE_AUTO;
+
+/* Whether the BDD engine reorders the atoms by sifting as the BDD grows. */
+bool bdd_sifting = false;
+
+/* The names read from the file, interned. */
+SYMBOL_TABLE name_table;
+
+/* The predicate names read from the file, interned. */
+SYMBOL_TABLE predicate_table;
+
 /* A list of names read from the file. */
 char** names;
 
@@ -40,708 +485,4268 @@ PREDICATE* predicates;
 /* Total number of predicates read from the file. */
 int num_predicates;
 
+/* Space allocated for predicates. */
+int predicates_capacity;
 
-/* A list of formulas read from the file. */
-Formula* formulas;
 
-/* Total number of formulas read from the file. */
-int num_formulas;
+/* All ground atoms met so far, indexed by atom ID. */
+ATOM* ground_atoms;
 
-/*
- * A buffer for reading in tokens from stdin or files.
- */
-char buff[BUFF_SIZE];
+/* Total number of ground atoms met so far. */
+int num_ground_atoms;
+
+/* Space allocated for ground_atoms. */
+int ground_atoms_capacity;
+
+/* The names that are arguments of the atoms. */
+int* atom_args;
+
+/* Total number of names used as arguments of the atoms. */
+int num_atom_args;
+
+/* Space allocated for atom_args. */
+int atom_args_capacity;
+
+/* Open addressing hash table of atom IDs, -1 for empty slots. */
+int* atom_table;
+
+/* Number of slots in the atom hash table, a power of 2. */
+int atom_table_size;
+
+/* Whether witnesses are written to witnesses_satisfiability.txt. */
+bool witness_to_file = true;
+
+/* The atom IDs of the last witness found. */
+int* witness_atoms;
+
+/* Total number of atoms in the last witness found. */
+int num_witness_atoms;
+
+/* Space allocated for witness_atoms. */
+int witness_atoms_capacity;
+
+/* The formulas being read. */
+TOKENIZER input;
+
+/* Why the last formula parsed is not a formula, if it is not. */
+PARSE_ERROR parse_error;
+
+/* Blocks of freed arenas, kept to be used again. */
+ARENA_BLOCK* spare_blocks;
 
 /*
- * A buffer for reading user input.
+ * A buffer for the names of an atom.
  */
-char input_buffer[BUFF_SIZE * 10];
+int  args_buff[BUFF_SIZE];
+
+/* The values true and false while simplifying; never part of a formula. */
+formula constant_nodes[2];
+#define FALSE_NODE (&constant_nodes[0])
+#define TRUE_NODE  (&constant_nodes[1])
+
+#ifdef REASON_STATS
+/* Counters and timers of the phases. */
+STATS stats;
+
+const char* phase_names[NUM_PHASES] = {
+    "load", "parse", "compile", "eval", "search"
+};
+#endif
 
 /* ==================== Helper Functions =====================*/
-/* 
- * Count the number of valid tokens in a file.
- * This function can be called before reading the names.txt file 
- * and the predicates.txt file for preparing a large enough array
- * to hold the names and predicates.
- */
-int count_tokens(char* filename) {
-    FILE* file = fopen(filename, "r");
-    char c;
-    int  i = 0;            /* Current index in the buffer. */
-    int  token_count = 0;  /* Number of tokens read. */ 
-    
-    while ((c = fgetc(file)) != EOF) {
-        if (c != '\n' && c != '\t' && c != ' ' && c != '\r') {
-            if (i != 0) {
-                token_count++;
-                i = 0;
-            }
-        }
-        else {
-            i++;
-        }
-    }
-    
-    if (i != 0) {
-        token_count++;
-        i = 0;
-    }
-    fclose(file);
-    return token_count;
+#ifdef REASON_STATS
+uint64_t stat_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-/*
- * Convert a string to a predicate structure and save it.
- */
-void setPredicate(char str[], PREDICATE* predicate) {
-    char deli[10] = "/\n";
-    /* 1. Get predicate name. */
-    char* token = strtok(str, deli);
-    predicate->name = calloc(sizeof(char), strlen(token) + 1);
-    strcpy(predicate->name, token);
-    
-    /* 2. Get predicate arity. */
-    token = strtok(NULL, deli);
-    predicate->arity = atoi(token);
+void stat_stop(int phase, uint64_t start) {
+    stats.phase_ns[phase] += stat_clock() - start;
+    stats.phase_calls[phase]++;
 }
+#endif
 
 /*
- * Search for a constant in the names array.
- * Return its index if the name exists, otherwise return -1.
+ * Get all of the file, from its current position, into the view. Return
+ * false if it cannot be read.
  */
-int getConstantIndex(char* constant_name) {
-    int i;
-    for (i=0; i<num_names; i++) {
-        if (strcmp(names[i], constant_name) == 0) {
-            return i;
+bool view_open(FILE* file, FILE_VIEW* view) {
+    struct stat st;
+    off_t offset = ftello(file);
+    view->mapped = false;
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+        offset >= 0 && offset < st.st_size) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            view->data = (char*)data + offset;
+            view->size = st.st_size - offset;
+            view->mapped = true;
+            view->mapping = data;
+            view->mapping_size = st.st_size;
+            return true;
         }
     }
-    return -1;
-}
-
-/*
- * Search for a predicate in the predicate array.
- * Return its index if the predicate exists, otherwise return -1.
- */
-int getPredicateIndex(char* predicate_name) {
-    int i;
-    for (i=0; i<num_predicates; i++) {
-        if (strcmp(predicates[i].name, predicate_name) == 0) {
-            return i;
+    
+    /* Not a regular file, or mmap failed: read it all, doubling the buffer. */
+    size_t capacity = CHUNK_SIZE;
+    view->data = malloc(capacity);
+    view->size = 0;
+    size_t n;
+    while ((n = fread(view->data + view->size, 1, capacity - view->size, file)) > 0) {
+        view->size += n;
+        if (view->size == capacity) {
+            capacity *= 2;
+            view->data = realloc(view->data, capacity);
         }
     }
-    return -1;
+    return !ferror(file);
 }
 
-
-bool special_symbol(char c) {
-    return (c == ' ' || c == '\r' || c == '\n' ||
-            c == '\t' || c == '[' || c == ']' || c == EOF);
+void view_close(FILE_VIEW* view) {
+    if (view->mapped) {
+        munmap(view->mapping, view->mapping_size);
+    }
+    else {
+        free(view->data);
+    }
 }
 
-bool special_non_space_symbol(char c) {
-    return (c == '[' || c == ']');
+bool is_blank(char c) {
+    return (c == ' ' || c == '\r' || c == '\n' || c == '\t');
 }
 
-/**
- * Read user input from console and save into the input buffer.
+/*
+ * Return the position of the first byte from i on that is blank (or, if
+ * blank is false, that is not), or size if there is none. Where SSE2 is
+ * available, 16 bytes are classified at once.
  */
-void read_user_input() {
-    char c;
-    int i = 0;
-    while ((c = fgetc(stdin)) != EOF) {
-        input_buffer[i++] = c;
+size_t scan_blanks(const char* data, size_t i, size_t size, bool blank) {
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (i + 16 <= size) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, space),
+                                              _mm_cmpeq_epi8(x, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(x, newline),
+                                              _mm_cmpeq_epi8(x, carriage)));
+        unsigned mask = _mm_movemask_epi8(m);
+        if (!blank) {
+            mask = ~mask & 0xFFFF;
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < size && is_blank(data[i]) != blank) {
+        i++;
     }
-    input_buffer[i] = '\0';
+    return i;
 }
 
 /*
- * Get the next token from stdin.
- * i is the current position that we have read.
+ * Get the next word of the view from *pos on, between blanks, into word
+ * and len, and move *pos past it. Return false if there is none.
  */
-void nextToken(int* i) {
-    /* get rid of all the spaces and new line symbols */
-    char c = input_buffer[*i];
-    while (c == ' ' || c == '\r' || c == '\n' || c == '\t') {
-        (*i)++;
-        c = input_buffer[*i];
-    }
-    
-    // 1. If c is an empty character, return an empty string.
-    if (c == '\0') {
-        buff[0] = '\0';
-        return;
-    }
-    
-    // 2. for special symbols, return as a token
-    int j = 0;
-    if (special_non_space_symbol(c)) {
-        buff[0] = c;
-        buff[1] = '\0';
-        (*i)++;
-        return;
-    }
-    else {
-        buff[j] = c;
-        while (!special_symbol(c)) {
-            buff[j++] = c;
-            (*i)++;
-            c = input_buffer[*i];
-        }
-        buff[j] = '\0';
+bool next_word(FILE_VIEW* view, size_t* pos, const char** word, int* len) {
+    size_t start = scan_blanks(view->data, *pos, view->size, false);
+    if (start == view->size) {
+        *pos = start;
+        return false;
     }
+    size_t end = scan_blanks(view->data, start, view->size, true);
+    *word = view->data + start;
+    *len = end - start;
+    *pos = end;
+    return true;
 }
 
 /*
- * Recursively read formula components from the input buffer, and
- * form a complete formula.
+ * Return size bytes from the arena, aligned for any type.
  */
-Formula recursive_make_formula(int* i) {
-    nextToken(i);
-    
-    if (strlen(buff) == 0) {
-        return NULL;
-    }
-    Formula f = malloc(sizeof(formula));
-    
-    /* 1. If next token is '[', it then has 2 components. */
-    if (strcmp(buff, "[") == 0) {
-        f->arity = 2;
-        f->sub_f1 = recursive_make_formula(i);
-        if (f->sub_f1 == NULL) {
-            free(f);
-            return NULL;
-        }
-        
-        nextToken(i);
-        
-        if (strlen(buff) == 0) {
-            return NULL;
-        }
-        else if (strcmp(buff, "and") != 0 && strcmp(buff, "or") != 0 &&
-            strcmp(buff, "implies") != 0 && strcmp(buff, "iff") != 0) {
-            return NULL;
-        }
-        else {
-            f->word = calloc(sizeof(char), strlen(buff) + 1);
-            sprintf(f->word, "%s", buff);
-        }
-        
-        f->sub_f2 = recursive_make_formula(i);
-        if (f->sub_f2 == NULL) {
-            free(f);
-            return NULL;
+void* arena_alloc(ARENA* arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ARENA_BLOCK* block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = block == NULL ? ARENA_BLOCK_SIZE : 2 * block->size;
+        if (block_size < size) {
+            block_size = size;
         }
         
-        nextToken(i);
-        if (strlen(buff) == 0) {
-            free(f);
-            return NULL;
+        /* Reuse a spare block if it is large enough. */
+        ARENA_BLOCK** spare = &spare_blocks;
+        while (*spare != NULL && (*spare)->size < block_size) {
+            spare = &(*spare)->next;
         }
-        else if (strcmp(buff, "]") != 0) {
-            return NULL;
+        if (*spare != NULL) {
+            block = *spare;
+            *spare = block->next;
         }
         else {
-            return f;
-        }
-    }
-    /* 2. If next token is 'not', the formula has only one formula. */
-    else if (strcmp(buff, "not") == 0) {
-        f->arity = 1;
-        f->word = calloc(sizeof(char), 4);
-        sprintf(f->word, "%s", "not");
-        
-        f->sub_f1 = recursive_make_formula(i);
-        if (f->sub_f1 == NULL) {
-            free(f);
-            return NULL;
+            block = malloc(sizeof(ARENA_BLOCK) + block_size);
+            block->size = block_size;
         }
-        
-        f->sub_f2 = NULL;
-        return f;
-    }
-    
-    /* These key words cannot exists by themselves. */
-    else if (strcmp(buff, "]") == 0 || strcmp(buff, "and") == 0 || 
-             strcmp(buff, "or") == 0 || strcmp(buff, "implies") == 0 || 
-             strcmp(buff, "iff") == 0) {
-        free(f);
-        return NULL;
-    }
-
-    /* 3. If the next token is a normal string, simply attach it to the
-     *    formula word.
-     */
-    else {
-        f->arity = 0;
-        f->sub_f1 = NULL;
-        f->sub_f2 = NULL;
-        f->word = calloc(sizeof(char), strlen(buff) + 1);
-        sprintf(f->word, "%s", buff);
-        return f;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
     }
+    void* p = block->data + block->used;
+    block->used += size;
+    return p;
 }
 
-/**
- * Check whether a single function is syntactically correct.
+/*
+ * Give back all the memory of the arena. Its blocks are kept for later
+ * arenas, at most one of each size.
  */
-bool check_single_function(char* words) {
-    int i = 0;
-    int j = 0;
-    int len = strlen(words);
-    
-    /* Stage 1: Capture predicate and check whether the predicate is valid. */
-    int predicateIndex = -1;
-    while (words[i] != '(') {
-        if (words[i] == '\0') {
-            break; 
-        }
-        buff[j] = words[i];
-        i++;
-        j++;
-    }
-    buff[j] = '\0';
-    predicateIndex = getPredicateIndex(buff);
-    if (predicateIndex == -1) {
-        return false;
+void arena_free(ARENA* arena) {
+    while (arena->blocks != NULL) {
+        ARENA_BLOCK* block = arena->blocks;
+        arena->blocks = block->next;
+        block->next = spare_blocks;
+        spare_blocks = block;
     }
     
-    /* Stage 2: Counting and checking arguments. */
-    int arity_count = predicates[predicateIndex].arity;
-    int k;
-    for (k = 0; k < arity_count; k++) {
-        i++;
-        j = 0;
-        if (words[i] == ',') {
-            return false;
-        }
-        else if (words[i] == '\0') {
-            return false;
-        }
-        else {
-            while (words[i] != ',' && words[i] != ')') {
-                buff[j] = words[i];
-                i++;
-                j++;
+    /* Keep the spare list short: at most one block of each size. */
+    ARENA_BLOCK** spare = &spare_blocks;
+    while (*spare != NULL) {
+        ARENA_BLOCK** other = &(*spare)->next;
+        while (*other != NULL) {
+            if ((*other)->size == (*spare)->size) {
+                ARENA_BLOCK* duplicate = *other;
+                *other = duplicate->next;
+                free(duplicate);
             }
-            buff[j] = '\0';
-            if (getConstantIndex(buff) == -1) {
-                return false;
+            else {
+                other = &(*other)->next;
             }
         }
+        spare = &(*spare)->next;
     }
-    
-    /* 3. If there are still some tokens left, the formula is invalid. */
-    if (arity_count > 0) {
-        i++;
-    }
-    
-    while (words[i] == ' ' || words[i] == '\t' ||
-           words[i] == '\n' || words[i] == '\n') {
-        i++;
-    }
-    if (words[i] != '\0') {
-        return false;
-    }
-    return true;
 }
 
 /*
- * Convert the string in buffer to a fact atom, and save it into the
- * interpretation atom list.
+ * FNV-1a hash of a string of the given length.
  */
-void save_atom(char buff[], Interpretation interp) {
-    /* 1. Create a new atom. */
-    char* atom = calloc(sizeof(char), strlen(buff) + 1);
-    strcpy(atom, buff);
-    
-    /* 2. Save the ave to the interpretation. */
-    if (interp->atoms == NULL) {
-        interp->num_atoms = 1;
-        interp->atoms = malloc(sizeof(char*));
-        interp->atoms[0] = atom;
-    }
-    else {
-        int i = interp->num_atoms;
-        interp->atoms = realloc(interp->atoms, sizeof(char*) * (i + 1));
-        interp->atoms[i] = atom;
-        (interp->num_atoms)++;
+unsigned hash_string(const char* str, int len) {
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)str[i]) * 16777619u;
     }
+    return h;
 }
 
-/**
- * Check whether a given atom is true by the given interpretation.
+/*
+ * Prepare an empty symbol table with room for about size strings.
  */
-bool fact_exist(char* atom, Interpretation interp) {
-    int num_facts = interp->num_atoms;
+void symbol_table_init(SYMBOL_TABLE* table, int size) {
+    int capacity = 16;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    table->arena_size = 0;
+    table->arena_capacity = capacity * 8;
+    table->arena = malloc(table->arena_capacity);
+    table->num_strings = 0;
+    table->capacity = capacity;
+    table->offsets = malloc(sizeof(int) * capacity);
+    table->hashes = malloc(sizeof(unsigned) * capacity);
+    table->num_slots = 2 * capacity;
+    table->slots = malloc(sizeof(int) * table->num_slots);
     int i;
-    for (i=0; i<num_facts; i++) {
-        if (strcmp(interp->atoms[i], atom) == 0) {
-            return true;
-        }
+    for (i = 0; i < table->num_slots; i++) {
+        table->slots[i] = -1;
     }
-    return false;
 }
 
-
-bool assumption_exist(char* atom, assumption* ass) {
-    if (ass->num_atoms == 0) {
-        return false;
-    }
-    else {
-        int i;
-        int num_atoms = ass->num_atoms;
-        for (i = 0; i < num_atoms; i++) {
-            if (strcmp(ass->atoms[i], atom) == 0) {
-                return true;
-            }
+/*
+ * Return the slot where a string of the given length and hash is, or the
+ * empty slot where it would go.
+ */
+int symbol_slot(SYMBOL_TABLE* table, const char* str, int len, unsigned h) {
+    int mask = table->num_slots - 1;
+    int slot = h & mask;
+    while (table->slots[slot] != -1) {
+        int index = table->slots[slot];
+        const char* other = table->arena + table->offsets[index];
+        if (table->hashes[index] == h && strncmp(other, str, len) == 0 &&
+            other[len] == '\0') {
+            break;
         }
-        return false;
+        slot = (slot + 1) & mask;
     }
+    return slot;
 }
 
-void add_to_assumption(char* atom, assumption* ass) {
-    if (ass->num_atoms == 0) {
-        ass->atoms = malloc(sizeof(char*));
-        ass->atoms[0] = calloc(sizeof(char), strlen(atom) + 1);
-        strcpy(ass->atoms[0], atom);
-        ass->num_atoms = 1;
-    }
-    else {
-        int num_atoms = ass->num_atoms;
-        ass->atoms = realloc(ass->atoms, sizeof(char*) * (num_atoms + 1));
-        ass->atoms[num_atoms] = calloc(sizeof(char), strlen(atom) + 1);
-        strcpy(ass->atoms[num_atoms], atom);
-        ass->num_atoms = num_atoms + 1;
+/*
+ * Return the index of a string of the given length, or -1 if it is not
+ * in the table.
+ */
+int symbol_find(SYMBOL_TABLE* table, const char* str, int len) {
+    STAT_ADD(symbol_lookups, 1);
+    if (table->num_slots == 0) {
+        return -1;
     }
+    return table->slots[symbol_slot(table, str, len, hash_string(str, len))];
 }
 
 /*
- * Save all atoms that are not listed in the interpretation to 
- * the assumption list.
+ * Return the index of a string of the given length, adding it to the
+ * table if it is not there yet.
  */
-void make_assumptions(Formula formula, assumption* ass) {
-    if (formula != NULL) {
-        if (strcmp(formula->word, "and") == 0 || strcmp(formula->word, "or") == 0 || 
-            strcmp(formula->word, "iff") == 0 || strcmp(formula->word, "implies") == 0) {
-            make_assumptions(formula->sub_f1, ass);
-            make_assumptions(formula->sub_f2, ass);
-        }
-        else if (strcmp(formula->word, "not") == 0) {
-            make_assumptions(formula->sub_f1, ass);
+int symbol_add(SYMBOL_TABLE* table, const char* str, int len) {
+    unsigned h = hash_string(str, len);
+    int slot = symbol_slot(table, str, len, h);
+    if (table->slots[slot] != -1) {
+        return table->slots[slot];
+    }
+    
+    /* 1. Copy the string to the arena. */
+    if (table->arena_size + len + 1 > table->arena_capacity) {
+        while (table->arena_size + len + 1 > table->arena_capacity) {
+            table->arena_capacity *= 2;
+        }
+        table->arena = realloc(table->arena, table->arena_capacity);
+    }
+    int index = table->num_strings++;
+    if (index == table->capacity) {
+        table->capacity *= 2;
+        table->offsets = realloc(table->offsets, sizeof(int) * table->capacity);
+        table->hashes = realloc(table->hashes, sizeof(unsigned) * table->capacity);
+    }
+    table->offsets[index] = table->arena_size;
+    table->hashes[index] = h;
+    memcpy(table->arena + table->arena_size, str, len);
+    table->arena[table->arena_size + len] = '\0';
+    table->arena_size += len + 1;
+    table->slots[slot] = index;
+    
+    /* 2. Keep the load factor of the hash table at most 1/2. */
+    if (2 * table->num_strings > table->num_slots) {
+        int num_slots = table->num_slots * 2;
+        int i;
+        free(table->slots);
+        table->slots = malloc(sizeof(int) * num_slots);
+        for (i = 0; i < num_slots; i++) {
+            table->slots[i] = -1;
+        }
+        table->num_slots = num_slots;
+        for (i = 0; i < table->num_strings; i++) {
+            slot = table->hashes[i] & (num_slots - 1);
+            while (table->slots[slot] != -1) {
+                slot = (slot + 1) & (num_slots - 1);
+            }
+            table->slots[slot] = i;
+        }
+    }
+    return index;
+}
+
+/*
+ * Return the string of the given index.
+ */
+char* symbol_string(SYMBOL_TABLE* table, int index) {
+    return table->arena + table->offsets[index];
+}
+
+/*
+ * Convert a string of the form name/arity to a predicate and save it,
+ * unless a predicate of that name has been saved already.
+ */
+void setPredicate(const char* str, int size) {
+    const char* slash = memchr(str, '/', size);
+    int len = slash == NULL ? size : (int)(slash - str);
+    int index = symbol_add(&predicate_table, str, len);
+    if (index < num_predicates) {
+        return;
+    }
+    if (num_predicates == predicates_capacity) {
+        predicates_capacity = predicates_capacity == 0 ? 16 : 2 * predicates_capacity;
+        predicates = realloc(predicates, sizeof(PREDICATE) * predicates_capacity);
+    }
+    predicates[index].name = NULL;
+    int arity = 0;
+    if (slash != NULL) {
+        const char* digit;
+        for (digit = slash + 1; digit < str + size && isdigit((unsigned char)*digit); digit++) {
+            arity = 10 * arity + (*digit - '0');
+        }
+    }
+    predicates[index].arity = arity;
+    num_predicates++;
+}
+
+/*
+ * Search for a constant in the names table.
+ * Return its index if the name exists, otherwise return -1.
+ */
+int getConstantIndex(char* constant_name) {
+    return symbol_find(&name_table, constant_name, strlen(constant_name));
+}
+
+/*
+ * Search for a predicate in the predicates table.
+ * Return its index if the predicate exists, otherwise return -1.
+ */
+int getPredicateIndex(char* predicate_name) {
+    return symbol_find(&predicate_table, predicate_name, strlen(predicate_name));
+}
+
+/*
+ * FNV-1a hash of a predicate index and the indexes of its names.
+ */
+unsigned hash_atom(int predicate, int* args, int arity) {
+    unsigned h = 2166136261u;
+    int i;
+    h = (h ^ (unsigned)predicate) * 16777619u;
+    for (i = 0; i < arity; i++) {
+        h = (h ^ (unsigned)args[i]) * 16777619u;
+    }
+    return h;
+}
+
+bool same_atom(int id, int predicate, int* args, int arity) {
+    ATOM* atom = &ground_atoms[id];
+    if (atom->predicate != predicate) {
+        return false;
+    }
+    return arity == 0 ||
+           memcmp(&atom_args[atom->first_arg], args, sizeof(int) * arity) == 0;
+}
+
+/*
+ * Double the size of the atom hash table and reinsert all atoms,
+ * using their stored hashes.
+ */
+void grow_atom_table() {
+    int size = atom_table_size == 0 ? 64 : atom_table_size * 2;
+    int i;
+    free(atom_table);
+    atom_table = malloc(sizeof(int) * size);
+    for (i = 0; i < size; i++) {
+        atom_table[i] = -1;
+    }
+    atom_table_size = size;
+    for (i = 0; i < num_ground_atoms; i++) {
+        unsigned slot = ground_atoms[i].hash & (size - 1);
+        while (atom_table[slot] != -1) {
+            slot = (slot + 1) & (size - 1);
+        }
+        atom_table[slot] = i;
+    }
+}
+
+/*
+ * Return the ID of the atom made of a predicate and the indexes of its
+ * names, interning the atom if it has not been met yet.
+ */
+int intern_atom(int predicate, int* args) {
+    int arity = predicates[predicate].arity;
+    unsigned h = hash_atom(predicate, args, arity);
+    if (2 * (num_ground_atoms + 1) > atom_table_size) {
+        grow_atom_table();
+    }
+    unsigned slot = h & (atom_table_size - 1);
+    while (atom_table[slot] != -1) {
+        int id = atom_table[slot];
+        if (ground_atoms[id].hash == h && same_atom(id, predicate, args, arity)) {
+            return id;
+        }
+        slot = (slot + 1) & (atom_table_size - 1);
+    }
+    
+    /* A new atom. */
+    if (num_ground_atoms == ground_atoms_capacity) {
+        ground_atoms_capacity = ground_atoms_capacity == 0 ? 64 : 2 * ground_atoms_capacity;
+        ground_atoms = realloc(ground_atoms, sizeof(ATOM) * ground_atoms_capacity);
+    }
+    while (num_atom_args + arity > atom_args_capacity) {
+        atom_args_capacity = atom_args_capacity == 0 ? 64 : 2 * atom_args_capacity;
+        atom_args = realloc(atom_args, sizeof(int) * atom_args_capacity);
+    }
+    int id = num_ground_atoms++;
+    ground_atoms[id].predicate = predicate;
+    ground_atoms[id].first_arg = num_atom_args;
+    ground_atoms[id].hash = h;
+    if (arity > 0) {
+        memcpy(&atom_args[num_atom_args], args, sizeof(int) * arity);
+        num_atom_args += arity;
+    }
+    atom_table[slot] = id;
+    return id;
+}
+
+/*
+ * Split the text of an atom, len bytes long and not necessarily ended by
+ * '\0', into its predicate and names, and return the ID of the atom.
+ * Return -1 if the text is not an atom built from the predicates and names
+ * that have been read, and, if error is not NULL, store why and the offset
+ * in the text of the first byte that is wrong.
+ */
+int scan_atom(const char* words, int len, PARSE_ERROR* error) {
+    const char* last = words + len;
+    const char* wrong = words;
+    const char* reason = NULL;
+    
+    /* 1. Capture the predicate. */
+    const char* open = memchr(words, '(', len);
+    int predicate = symbol_find(&predicate_table, words,
+                                open != NULL ? open - words : len);
+    int arity = predicate == -1 ? 0 : predicates[predicate].arity;
+    if (predicate == -1) {
+        reason = "unknown predicate";
+    }
+    else if (arity == 0) {
+        if (open == NULL) {
+            return intern_atom(predicate, args_buff);
+        }
+        wrong = open;
+        reason = "predicate takes no names";
+    }
+    else if (open == NULL) {
+        wrong = last;
+        reason = "expected (";
+    }
+    else if (arity > BUFF_SIZE) {
+        reason = "predicate takes too many names";
+    }
+    else {
+        /* 2. Capture the names, separated by commas and closed by ')'. */
+        const char* start = open + 1;
+        int k;
+        for (k = 0; k < arity; k++) {
+            const char* end = start;
+            while (end < last && *end != ',' && *end != ')') {
+                end++;
+            }
+            char separator = k == arity - 1 ? ')' : ',';
+            if (end == last || *end != separator) {
+                wrong = end;
+                reason = end == last ? (separator == ')' ? "expected )" : "expected ,") :
+                         *end == ')' ? "too few names" : "too many names";
+                break;
+            }
+            args_buff[k] = symbol_find(&name_table, start, end - start);
+            if (args_buff[k] == -1) {
+                wrong = start;
+                reason = "unknown name";
+                break;
+            }
+            start = end + 1;
+        }
+        
+        /* 3. Nothing can follow the closing parenthesis. */
+        if (k == arity) {
+            if (start == last) {
+                return intern_atom(predicate, args_buff);
+            }
+            wrong = start;
+            reason = "unexpected text after )";
+        }
+    }
+    if (error != NULL) {
+        error->offset = wrong - words;
+        error->reason = reason;
+    }
+    return -1;
+}
+
+/*
+ * As scan_atom(), without saying why the text is not an atom.
+ */
+int resolve_atom(const char* words, int len) {
+    return scan_atom(words, len, NULL);
+}
+
+/*
+ * Write the text of an atom to a file.
+ */
+void print_atom(FILE* file, int id) {
+    ATOM* atom = &ground_atoms[id];
+    PREDICATE* predicate = &predicates[atom->predicate];
+    fputs(predicate->name, file);
+    int k;
+    for (k = 0; k < predicate->arity; k++) {
+        fputc(k == 0 ? '(' : ',', file);
+        fputs(names[atom_args[atom->first_arg + k]], file);
+    }
+    if (predicate->arity > 0) {
+        fputc(')', file);
+    }
+}
+
+bool is_space(char c) {
+    return (c == ' ' || c == '\r' || c == '\n' || c == '\t' || c == '\0');
+}
+
+/*
+ * Stop reading from the file of the tokenizer, if any.
+ */
+void tokenizer_close(TOKENIZER* in) {
+    if (in->data != NULL) {
+        if (in->mapped) {
+            munmap(in->data, in->capacity);
+        }
+        else {
+            free(in->data);
+        }
+    }
+    in->data = NULL;
+    in->file = NULL;
+}
+
+/*
+ * Start reading formulas ended by the delimiter (EOF if there is only one)
+ * from the file, from its current position.
+ */
+void tokenizer_open(TOKENIZER* in, FILE* file, int delimiter) {
+    tokenizer_close(in);
+    in->file = file;
+    in->delimiter = delimiter;
+    in->size = 0;
+    in->pos = 0;
+    in->eof = false;
+    in->pending = false;
+    in->token_len = 0;
+    in->dropped = 0;
+    in->record_start = 0;
+    
+    struct stat st;
+    off_t offset = ftello(file);
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size > 0 && offset >= 0 && offset <= st.st_size) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data != MAP_FAILED) {
+            in->data = data;
+            in->size = in->capacity = st.st_size;
+            in->pos = in->record_start = offset;
+            in->mapped = true;
+            in->eof = true;
+            return;
+        }
+    }
+    in->mapped = false;
+    in->capacity = CHUNK_SIZE;
+    in->data = malloc(in->capacity);
+}
+
+/*
+ * Read the next chunk of the file, dropping the bytes before keep, which
+ * moves to the start of data. Return false if there is nothing more to
+ * read.
+ */
+bool tokenizer_fill(TOKENIZER* in, size_t keep) {
+    if (in->eof) {
+        return false;
+    }
+    memmove(in->data, in->data + keep, in->size - keep);
+    in->size -= keep;
+    in->pos -= keep;
+    in->dropped += keep;
+    if (in->size == in->capacity) {
+        in->capacity *= 2;
+        in->data = realloc(in->data, in->capacity);
+    }
+    size_t n = fread(in->data + in->size, 1, in->capacity - in->size, in->file);
+    if (n == 0) {
+        in->eof = true;
+        return false;
+    }
+    in->size += n;
+    return true;
+}
+
+/*
+ * Get the next token of the current formula: '[', ']', or a word ended by
+ * a space or a bracket. At the end of the formula, the token is empty and
+ * the delimiter is left to be skipped by tokenizer_skip_formula().
+ */
+void next_token(TOKENIZER* in) {
+    if (in->pending) {
+        in->pending = false;
+        return;
+    }
+    in->token = "";
+    in->token_len = 0;
+    
+    /* 1. Get rid of all the spaces and new line symbols. */
+    while (true) {
+        if (in->pos == in->size && !tokenizer_fill(in, in->pos)) {
+            return;
+        }
+        char c = in->data[in->pos];
+        if ((unsigned char)c == in->delimiter) {
+            return;
+        }
+        if (!is_space(c)) {
+            break;
+        }
+        in->pos++;
+    }
+    
+    /* 2. Brackets are tokens by themselves; words go on until a space, a
+     *    bracket or the delimiter. */
+    size_t start = in->pos;
+    char c = in->data[in->pos++];
+    if (c != '[' && c != ']') {
+        while (true) {
+            if (in->pos == in->size) {
+                /* The token moves to the start of data, even when nothing
+                 * more can be read. */
+                size_t len = in->pos - start;
+                bool more = tokenizer_fill(in, start);
+                start = in->pos - len;
+                if (!more) {
+                    break;
+                }
+            }
+            c = in->data[in->pos];
+            if ((unsigned char)c == in->delimiter || is_space(c) ||
+                c == '[' || c == ']') {
+                break;
+            }
+            in->pos++;
+        }
+    }
+    in->token = in->data + start;
+    in->token_len = in->pos - start;
+    STAT_ADD(tokens, 1);
+}
+
+/*
+ * Return true if the current token is the given word.
+ */
+bool token_is(TOKENIZER* in, const char* word) {
+    return in->token_len == (int)strlen(word) &&
+           memcmp(in->token, word, in->token_len) == 0;
+}
+
+/*
+ * Skip what is left of the current formula, and its delimiter.
+ */
+void tokenizer_skip_formula(TOKENIZER* in) {
+    in->pending = false;
+    while (true) {
+        if (in->pos == in->size && !tokenizer_fill(in, in->pos)) {
+            return;
+        }
+        if ((unsigned char)in->data[in->pos++] == in->delimiter) {
+            in->record_start = in->dropped + in->pos;
+            return;
+        }
+    }
+}
+
+/*
+ * Return true if all of the file has been read.
+ */
+bool tokenizer_at_end(TOKENIZER* in) {
+    return in->pos == in->size && !tokenizer_fill(in, in->pos);
+}
+
+/*
+ * Hash of a node: leaves that are atoms by their ID, other leaves by
+ * their word, and connectives by their word and subformulas.
+ */
+unsigned hash_node(const char* word, int len, int atom, Formula sub_f1, Formula sub_f2) {
+    unsigned h = atom != -1 ? (2166136261u ^ (unsigned)atom) * 16777619u
+                            : hash_string(word, len);
+    h = (h ^ (unsigned)(sub_f1 != NULL ? sub_f1->id + 1 : 0)) * 16777619u;
+    h = (h ^ (unsigned)(sub_f2 != NULL ? sub_f2->id + 1 : 0)) * 16777619u;
+    return h;
+}
+
+/*
+ * Double the number of slots of the node table.
+ */
+void grow_node_table(NODE_TABLE* table) {
+    Formula* old_slots = table->slots;
+    int old_num_slots = table->num_slots;
+    table->num_slots = old_num_slots == 0 ? 64 : 2 * old_num_slots;
+    table->slots = calloc(sizeof(Formula), table->num_slots);
+    int i;
+    for (i = 0; i < old_num_slots; i++) {
+        Formula f = old_slots[i];
+        if (f != NULL) {
+            unsigned h = hash_node(f->word, strlen(f->word), f->atom, f->sub_f1, f->sub_f2);
+            int slot = h & (table->num_slots - 1);
+            while (table->slots[slot] != NULL) {
+                slot = (slot + 1) & (table->num_slots - 1);
+            }
+            table->slots[slot] = f;
+        }
+    }
+    free(old_slots);
+}
+
+/*
+ * Return the node with the given word, len bytes long, atom and
+ * subformulas, making it if the formula being parsed does not have it yet.
+ * A leaf that is an atom is known by its ID, and has no word; the word of
+ * any other leaf is copied, to be resolved later. Connectives are static
+ * strings, with an atom of -1. Nodes made from correct parts are correct.
+ */
+Formula make_node(NODE_TABLE* table, int arity, const char* word, int len, int atom,
+                  Formula sub_f1, Formula sub_f2) {
+    if (2 * (table->num_nodes + 1) > table->num_slots) {
+        grow_node_table(table);
+    }
+    unsigned h = hash_node(word, len, atom, sub_f1, sub_f2);
+    int slot = h & (table->num_slots - 1);
+    while (table->slots[slot] != NULL) {
+        Formula f = table->slots[slot];
+        if (f->arity == arity && f->sub_f1 == sub_f1 && f->sub_f2 == sub_f2 &&
+            f->atom == atom &&
+            (atom != -1 || (strncmp(f->word, word, len) == 0 && f->word[len] == '\0'))) {
+            return f;
+        }
+        slot = (slot + 1) & (table->num_slots - 1);
+    }
+    
+    Formula f = arena_alloc(table->arena, sizeof(formula));
+    STAT_ADD(nodes, 1);
+    f->arity = arity;
+    if (arity == 0 && atom != -1) {
+        f->word = "";
+    }
+    else if (arity == 0) {
+        char* copy = arena_alloc(table->arena, len + 1);
+        memcpy(copy, word, len);
+        copy[len] = '\0';
+        f->word = copy;
+    }
+    else {
+        f->word = word;
+    }
+    f->atom = atom;
+    f->sub_f1 = sub_f1;
+    f->sub_f2 = sub_f2;
+    f->id = table->num_nodes++;
+    f->refs = 0;
+    f->slot = -1;
+    f->checked = arity == 0 ? atom != -1 :
+                 sub_f1->checked && (sub_f2 == NULL || sub_f2->checked);
+    f->program = NULL;
+    f->arena = NULL;
+    f->mapping = NULL;
+    f->plan = NULL;
+    if (sub_f1 != NULL) {
+        sub_f1->refs++;
+    }
+    if (sub_f2 != NULL) {
+        sub_f2->refs++;
+    }
+    table->slots[slot] = f;
+    return f;
+}
+
+/*
+ * Return the binary connective that is the current token, or NULL.
+ */
+const char* binary_connective(TOKENIZER* in) {
+    static const char* connectives[] = {"and", "or", "implies", "iff"};
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (token_is(in, connectives[i])) {
+            return connectives[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Return the offset from the start of the current formula of a byte in the
+ * data of the tokenizer.
+ */
+long formula_offset(TOKENIZER* in, const char* at) {
+    return (long)(in->dropped + (at - in->data) - in->record_start);
+}
+
+/*
+ * Keep why the formula being parsed is not a formula, at the current
+ * token, or at the end of the formula if there is none, unless an earlier
+ * byte is known to be wrong.
+ */
+void parse_fail(TOKENIZER* in, const char* reason) {
+    if (parse_error.reason != NULL) {
+        return;
+    }
+    const char* at = in->token_len != 0 ? in->token : in->data + in->pos;
+    parse_error.offset = formula_offset(in, at);
+    parse_error.reason = in->token_len != 0 ? reason : "unexpected end of formula";
+}
+
+/*
+ * A formula the parser has started but not finished: a negation waiting
+ * for its subformula, or a binary formula waiting for its first
+ * subformula (sub_f1 is NULL) or for its second one.
+ */
+typedef struct {
+    int         arity;
+    Formula     sub_f1;
+    const char* word;
+} PARSE_FRAME;
+
+/*
+ * Read formula components from the tokenizer, and form a complete
+ * formula. Unfinished formulas are kept on a stack in the heap rather than
+ * on the call stack, so that nesting is only limited by memory. Each leaf
+ * is resolved to its atom as it is read; a leaf that is not an atom still
+ * gives a formula, that is not syntactically correct. parse_error keeps
+ * the first thing found wrong.
+ */
+Formula parse_formula(TOKENIZER* in, NODE_TABLE* table) {
+    int capacity = 64;
+    int top = 0;
+    PARSE_FRAME* stack = malloc(sizeof(PARSE_FRAME) * capacity);
+    Formula f = NULL;
+    while (true) {
+        /* 1. Open formulas until a leaf is found. */
+        next_token(in);
+        if (in->token_len == 0 || token_is(in, "]") || binary_connective(in) != NULL) {
+            /* These key words cannot exists by themselves. */
+            parse_fail(in, "expected a formula");
+            f = NULL;
+            break;
+        }
+        if (token_is(in, "[") || token_is(in, "not")) {
+            if (top == capacity) {
+                capacity *= 2;
+                stack = realloc(stack, sizeof(PARSE_FRAME) * capacity);
+            }
+            stack[top].arity = token_is(in, "[") ? 2 : 1;
+            stack[top].sub_f1 = NULL;
+            top++;
+            continue;
+        }
+        PARSE_ERROR error;
+        int atom = scan_atom(in->token, in->token_len, &error);
+        if (atom == -1 && parse_error.reason == NULL) {
+            parse_error.offset = formula_offset(in, in->token) + error.offset;
+            parse_error.reason = error.reason;
+        }
+        f = make_node(table, 0, in->token, in->token_len, atom, NULL, NULL);
+        
+        /* 2. Close the formulas that f completes. */
+        while (top > 0) {
+            PARSE_FRAME* frame = &stack[top - 1];
+            if (frame->arity == 1) {
+                f = make_node(table, 1, "not", 3, -1, f, NULL);
+                top--;
+            }
+            else if (frame->sub_f1 == NULL) {
+                /* f is the first subformula: a connective must follow. */
+                next_token(in);
+                frame->word = binary_connective(in);
+                frame->sub_f1 = f;
+                if (frame->word == NULL) {
+                    parse_fail(in, "expected and, or, implies or iff");
+                    f = NULL;
+                }
+                break;
+            }
+            else {
+                next_token(in);
+                if (!token_is(in, "]")) {
+                    parse_fail(in, "expected ]");
+                    f = NULL;
+                    break;
+                }
+                f = make_node(table, 2, frame->word, strlen(frame->word), -1,
+                              frame->sub_f1, f);
+                top--;
+            }
+        }
+        if (f == NULL || top == 0) {
+            break;
+        }
+    }
+    free(stack);
+    return f;
+}
+
+/*
+ * Parse the next formula of the tokenizer. Return NULL if it is not a
+ * formula.
+ */
+Formula parse_input(TOKENIZER* in) {
+    ARENA* arena = malloc(sizeof(ARENA));
+    arena->blocks = NULL;
+    NODE_TABLE table = {arena, NULL, 0, 0};
+    parse_error.reason = NULL;
+    Formula form = parse_formula(in, &table);
+    free(table.slots);
+    
+    /* If there are still extra tokens in the formula, return NULL. */
+    if (form != NULL) {
+        next_token(in);
+        if (in->token_len != 0) {
+            parse_fail(in, "unexpected text after the formula");
+        }
+    }
+    if (form == NULL || in->token_len != 0) {
+        arena_free(arena);
+        free(arena);
+        return NULL;
+    }
+    else {
+        form->arena = arena;
+        form->mapping = NULL;
+        return form;
+    }
+}
+
+/*
+ * Return the opcode of a syntactically correct formula node.
+ */
+uint8_t node_opcode(Formula formula) {
+    if (formula->arity == 0) {
+        return OP_ATOM;
+    }
+    else if (formula->arity == 1) {
+        return OP_NOT;
+    }
+    else if (strcmp(formula->word, "and") == 0) {
+        return OP_AND;
+    }
+    else if (strcmp(formula->word, "or") == 0) {
+        return OP_OR;
+    }
+    else if (strcmp(formula->word, "implies") == 0) {
+        return OP_IMPLIES;
+    }
+    else {
+        return OP_IFF;
+    }
+}
+
+/*
+ * Count the instructions of the code of a formula: one per node, plus, for
+ * a node with several parents, one to store it and one to load it for each
+ * parent but the first. Nodes are marked as seen with a slot of -2.
+ */
+int count_code(Formula formula) {
+    int capacity = 64;
+    int top = 0;
+    Formula* stack = malloc(sizeof(Formula) * capacity);
+    int size = 0;
+    formula->slot = -2;
+    stack[top++] = formula;
+    while (top > 0) {
+        Formula f = stack[--top];
+        size += f->refs > 1 ? 1 + f->refs : 1;
+        Formula subs[2] = {f->sub_f1, f->sub_f2};
+        int k;
+        for (k = 0; k < 2; k++) {
+            if (subs[k] != NULL && subs[k]->slot != -2) {
+                if (top == capacity) {
+                    capacity *= 2;
+                    stack = realloc(stack, sizeof(Formula) * capacity);
+                }
+                subs[k]->slot = -2;
+                stack[top++] = subs[k];
+            }
+        }
+    }
+    free(stack);
+    return size;
+}
+
+/*
+ * Append an instruction to the program.
+ */
+void emit(PROGRAM* program, uint8_t op, int32_t operand) {
+    program->ops[program->size] = op;
+    program->operands[program->size] = operand;
+    program->size++;
+}
+
+/*
+ * Emit the postfix code of a formula at the end of the program, and
+ * return the stack depth it needs. A node with several parents is computed
+ * the first time and loaded from its slot afterwards. Nodes are visited
+ * with a stack in the heap: state counts the subformulas already emitted.
+ */
+int emit_code(Formula formula, PROGRAM* program) {
+    typedef struct {
+        Formula f;
+        int     state;
+    } EMIT_FRAME;
+    int capacity = 64;
+    int top = 0;
+    EMIT_FRAME* stack = malloc(sizeof(EMIT_FRAME) * capacity);
+    int start = program->size;
+    stack[top].f = formula;
+    stack[top].state = 0;
+    top++;
+    while (top > 0) {
+        EMIT_FRAME* frame = &stack[top - 1];
+        Formula f = frame->f;
+        if (frame->state == 0 && f->slot >= 0) {
+            emit(program, OP_LOAD, f->slot);
+            top--;
+            continue;
+        }
+        if (frame->state < f->arity) {
+            Formula sub = frame->state == 0 ? f->sub_f1 : f->sub_f2;
+            frame->state++;
+            if (top == capacity) {
+                capacity *= 2;
+                stack = realloc(stack, sizeof(EMIT_FRAME) * capacity);
+            }
+            stack[top].f = sub;
+            stack[top].state = 0;
+            top++;
+            continue;
+        }
+        emit(program, node_opcode(f), f->atom);
+        if (f->refs > 1) {
+            f->slot = program->num_slots++;
+            emit(program, OP_STORE, f->slot);
+        }
+        top--;
+    }
+    free(stack);
+    
+    /* The depth is the highest the stack gets when running the code. */
+    int depth = 0;
+    int max_depth = 0;
+    int i;
+    for (i = start; i < program->size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_ATOM || op == OP_LOAD) {
+            depth++;
+        }
+        else if (op != OP_NOT && op != OP_STORE) {
+            depth--;
+        }
+        if (depth > max_depth) {
+            max_depth = depth;
+        }
+    }
+    return max_depth;
+}
+
+/*
+ * Return the compiled code of a syntactically correct formula, compiling
+ * it the first time.
+ */
+PROGRAM* compile_formula(Formula formula) {
+    if (formula->program == NULL) {
+        STAT_START(PHASE_COMPILE);
+        int size = count_code(formula);
+        PROGRAM* program = arena_alloc(formula->arena, sizeof(PROGRAM));
+        program->ops = arena_alloc(formula->arena, sizeof(uint8_t) * size);
+        program->operands = arena_alloc(formula->arena, sizeof(int32_t) * size);
+        program->size = 0;
+        program->num_slots = 0;
+        program->max_depth = emit_code(formula, program);
+        formula->program = program;
+        STAT_STOP(PHASE_COMPILE);
+    }
+    return formula->program;
+}
+
+/*
+ * Save all atoms of the program to the assumption list, in order of
+ * first occurrence.
+ */
+void make_assumptions(PROGRAM* program, assumption* ass) {
+    int i;
+    for (i = 0; i < program->size; i++) {
+        int atom = program->operands[i];
+        if (program->ops[i] == OP_ATOM && ass->index[atom] == -1) {
+            ass->index[atom] = ass->num_atoms;
+            ass->atoms[ass->num_atoms++] = atom;
+        }
+    }
+}
+
+/*
+ * Add a clause where it goes, with the guard if there is one.
+ */
+void add_clause(CLAUSES* clauses, int* lits, int num_lits) {
+    int clause[4];
+    memcpy(clause, lits, sizeof(int) * num_lits);
+    if (clauses->guard != 0) {
+        clause[num_lits++] = clauses->guard;
+    }
+    if (clauses->counter != NULL) {
+        counter_add_clause(clauses->counter, clause, num_lits);
+    }
+    else {
+        sat_add_clause(clauses->solver, clause, num_lits);
+    }
+}
+
+/*
+ * Tseitin encoding: add clauses stating that the returned literal is
+ * equivalent to the program. The atoms are the variables index + 1, after
+ * their index in the assumption list, and each binary connective gets a
+ * fresh variable, whose value follows from theirs.
+ */
+int tseitin_encode(PROGRAM* program, assumption* ass, CLAUSES* clauses) {
+    int* stack = malloc(sizeof(int) * (program->max_depth + program->num_slots));
+    int* memo = stack + program->max_depth;
+    int top = 0;
+    int i;
+    for (i = 0; i < program->size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_STORE) {
+            memo[program->operands[i]] = stack[top - 1];
+            continue;
+        }
+        else if (op == OP_LOAD) {
+            stack[top++] = memo[program->operands[i]];
+            continue;
+        }
+        else if (op == OP_ATOM) {
+            stack[top++] = ass->index[program->operands[i]] + 1;
+            continue;
+        }
+        else if (op == OP_NOT) {
+            stack[top - 1] = -stack[top - 1];
+            continue;
+        }
+        
+        int b = stack[--top];
+        int a = stack[--top];
+        int g = clauses->counter != NULL ? counter_new_var(clauses->counter)
+                                         : sat_new_var(clauses->solver);
+        if (clauses->counter != NULL) {
+            counter_define(clauses->counter, g);
+        }
+        /* IMPLIES is encoded as [not sub_f1 or sub_f2]. */
+        if (op == OP_IMPLIES) {
+            a = -a;
+        }
+        if (op == OP_AND) {
+            int c1[2] = {-g, a};
+            int c2[2] = {-g, b};
+            int c3[3] = {g, -a, -b};
+            add_clause(clauses, c1, 2);
+            add_clause(clauses, c2, 2);
+            add_clause(clauses, c3, 3);
+        }
+        else if (op == OP_OR || op == OP_IMPLIES) {
+            int c1[2] = {g, -a};
+            int c2[2] = {g, -b};
+            int c3[3] = {-g, a, b};
+            add_clause(clauses, c1, 2);
+            add_clause(clauses, c2, 2);
+            add_clause(clauses, c3, 3);
+        }
+        else {
+            int c1[3] = {-g, -a, b};
+            int c2[3] = {-g, a, -b};
+            int c3[3] = {g, a, b};
+            int c4[3] = {g, -a, -b};
+            add_clause(clauses, c1, 3);
+            add_clause(clauses, c2, 3);
+            add_clause(clauses, c3, 3);
+            add_clause(clauses, c4, 3);
+        }
+        stack[top++] = g;
+    }
+    if (clauses->counter != NULL) {
+        counter_define(clauses->counter, 0);
+    }
+    int root = stack[0];
+    free(stack);
+    return root;
+}
+
+/*
+ * Run the program with the atoms whose bit is set in truth taken as true.
+ * Atoms with an ID of at least num_atoms are false.
+ */
+bool run_program(PROGRAM* program, uint64_t* truth, int num_atoms) {
+    int size = program->max_depth + program->num_slots;
+    bool  small_stack[64] = {false};
+    bool* stack = size <= 64 ? small_stack : calloc(sizeof(bool), size);
+    bool* memo = stack + program->max_depth;
+    int top = 0;
+    int i;
+    for (i = 0; i < program->size; i++) {
+        bool b;
+        switch (program->ops[i]) {
+            case OP_STORE:
+                memo[program->operands[i]] = stack[top - 1];
+                break;
+            case OP_LOAD:
+                stack[top++] = memo[program->operands[i]];
+                break;
+            case OP_ATOM: {
+                int atom = program->operands[i];
+                STAT_ADD(fact_lookups, 1);
+                stack[top++] = atom < num_atoms &&
+                               (truth[atom / 64] >> (atom % 64) & 1) == 1;
+                break;
+            }
+            case OP_NOT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            case OP_AND:
+                b = stack[--top];
+                stack[top - 1] = stack[top - 1] && b;
+                break;
+            case OP_OR:
+                b = stack[--top];
+                stack[top - 1] = stack[top - 1] || b;
+                break;
+            case OP_IMPLIES:
+                b = stack[--top];
+                stack[top - 1] = !stack[top - 1] || b;
+                break;
+            default:
+                b = stack[--top];
+                stack[top - 1] = stack[top - 1] == b;
+                break;
+        }
+    }
+    bool result = stack[0];
+    if (stack != small_stack) {
+        free(stack);
+    }
+    return result;
+}
+
+/*
+ * Lay out the compiled code of a formula for is_true(), in the arena. A
+ * node is made for each instruction but OP_STORE and OP_LOAD, which only
+ * tell that a node is shared. Binary nodes start with the smaller
+ * subformula.
+ */
+PLAN* make_plan(PROGRAM* program, ARENA* arena) {
+    int num_nodes = 0;
+    int i;
+    for (i = 0; i < program->size; i++) {
+        if (program->ops[i] != OP_STORE && program->ops[i] != OP_LOAD) {
+            num_nodes++;
+        }
+    }
+    PLAN* plan = arena_alloc(arena, sizeof(PLAN));
+    plan->num_nodes = num_nodes;
+    plan->ops = arena_alloc(arena, sizeof(uint8_t) * num_nodes);
+    plan->subs = arena_alloc(arena, sizeof(int32_t) * 2 * num_nodes);
+    plan->first = arena_alloc(arena, sizeof(uint8_t) * num_nodes);
+    plan->cost = arena_alloc(arena, sizeof(uint32_t) * num_nodes);
+    plan->counts = arena_alloc(arena, sizeof(uint32_t) * 2 * num_nodes);
+    plan->stamps = arena_alloc(arena, sizeof(uint32_t) * num_nodes);
+    plan->values = arena_alloc(arena, sizeof(bool) * num_nodes);
+    plan->stack = arena_alloc(arena, sizeof(int32_t) * num_nodes);
+    plan->stamp = 0;
+    memset(plan->counts, 0, sizeof(uint32_t) * 2 * num_nodes);
+    memset(plan->stamps, 0, sizeof(uint32_t) * num_nodes);
+    
+    /* Run the code on node numbers: the stack holds the nodes of the
+     * subformulas computed so far, and kept values are nodes too. */
+    int32_t* kept = malloc(sizeof(int32_t) * (program->num_slots + 1));
+    int32_t* stack = plan->stack;
+    int top = 0;
+    int j = 0;
+    for (i = 0; i < program->size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_STORE) {
+            kept[program->operands[i]] = stack[top - 1];
+            continue;
+        }
+        if (op == OP_LOAD) {
+            stack[top++] = kept[program->operands[i]];
+            continue;
+        }
+        plan->ops[j] = op;
+        plan->first[j] = 0;
+        uint64_t cost = 1;
+        if (op == OP_ATOM) {
+            plan->subs[2 * j] = program->operands[i];
+        }
+        else if (op == OP_NOT) {
+            plan->subs[2 * j] = stack[--top];
+            cost += plan->cost[plan->subs[2 * j]];
+        }
+        else {
+            int b = stack[--top];
+            int a = stack[--top];
+            plan->subs[2 * j] = a;
+            plan->subs[2 * j + 1] = b;
+            cost += (uint64_t)plan->cost[a] + plan->cost[b];
+            plan->first[j] = plan->cost[b] < plan->cost[a];
+        }
+        plan->cost[j] = cost < UINT32_MAX ? cost : UINT32_MAX;
+        stack[top++] = j++;
+    }
+    free(kept);
+    return plan;
+}
+
+/*
+ * Return the value of the formula of the plan with the atoms whose bit is
+ * set in truth taken as true, and atoms with an ID of at least num_atoms
+ * false. A binary node first evaluates one subformula, and the other only
+ * if the first does not settle its value: false for and, true for or, and
+ * false on the left or true on the right for implies.
+ */
+bool run_plan(PLAN* plan, uint64_t* truth, int num_atoms) {
+    if (++plan->stamp == 0) {
+        memset(plan->stamps, 0, sizeof(uint32_t) * plan->num_nodes);
+        plan->stamp = 1;
+    }
+    uint32_t stamp = plan->stamp;
+    int32_t* stack = plan->stack;
+    int top = 0;
+    stack[top++] = plan->num_nodes - 1;
+    while (top > 0) {
+        int i = stack[top - 1];
+        if (plan->stamps[i] == stamp) {
+            top--;
+            continue;
+        }
+        bool value;
+        uint8_t op = plan->ops[i];
+        if (op == OP_ATOM) {
+            int atom = plan->subs[2 * i];
+            STAT_ADD(fact_lookups, 1);
+            value = atom < num_atoms && (truth[atom / 64] >> (atom % 64) & 1) == 1;
+        }
+        else if (op == OP_NOT) {
+            int sub = plan->subs[2 * i];
+            if (plan->stamps[sub] != stamp) {
+                stack[top++] = sub;
+                continue;
+            }
+            value = !plan->values[sub];
+        }
+        else {
+            int side = plan->first[i];
+            int a = plan->subs[2 * i + side];
+            int b = plan->subs[2 * i + 1 - side];
+            if (plan->stamps[a] != stamp) {
+                stack[top++] = a;
+                continue;
+            }
+            bool va = plan->values[a];
+            bool settled = (op == OP_AND && !va) || (op == OP_OR && va) ||
+                           (op == OP_IMPLIES && va == (side == 1));
+            if (settled) {
+                value = op != OP_AND;
+            }
+            else if (plan->stamps[b] != stamp) {
+                stack[top++] = b;
+                continue;
+            }
+            else {
+                bool vb = plan->values[b];
+                bool v1 = side == 0 ? va : vb;
+                bool v2 = side == 0 ? vb : va;
+                switch (op) {
+                    case OP_AND:
+                        value = v1 && v2;
+                        break;
+                    case OP_OR:
+                        value = v1 || v2;
+                        break;
+                    case OP_IMPLIES:
+                        value = !v1 || v2;
+                        break;
+                    default:
+                        value = v1 == v2;
+                        break;
+                }
+            }
+        }
+        plan->values[i] = value;
+        plan->stamps[i] = stamp;
+        plan->counts[2 * i + value]++;
+        top--;
+    }
+    return plan->values[plan->num_nodes - 1];
+}
+
+/*
+ * Return the expected cost of evaluating the binary node i of the plan
+ * starting with subformula a then, unless settled, b. The chance that a
+ * settles the node is taken from how often it was false or true, or is
+ * one half if it has not been evaluated yet.
+ */
+double expected_cost(PLAN* plan, int i, int side) {
+    int a = plan->subs[2 * i + side];
+    int b = plan->subs[2 * i + 1 - side];
+    uint8_t op = plan->ops[i];
+    if (op == OP_IFF) {
+        return (double)plan->cost[a] + plan->cost[b];
+    }
+    /* The value of a that settles the node. */
+    int settling = op == OP_OR || (op == OP_IMPLIES && side == 1);
+    double seen = (double)plan->counts[2 * a] + plan->counts[2 * a + 1];
+    double p = seen == 0 ? 0.5 : plan->counts[2 * a + settling] / seen;
+    return plan->cost[a] + (1 - p) * plan->cost[b];
+}
+
+/*
+ * Evaluate the program on SLICE_WORDS * 64 assignments at once, those
+ * numbered from base on, where bit j of an assignment number is the value
+ * of the j-th atom of the assumption list. Each atom becomes a bit pattern
+ * over the assignments, each connective a bitwise operation, and bit i of
+ * result[w] is the value on assignment base + 64 * w + i. stack must have
+ * room for (max_depth + num_slots) * SLICE_WORDS words.
+ */
+SIMD_CLONES
+void eval_slice(PROGRAM* program, assumption* ass, uint64_t base,
+                uint64_t* stack, uint64_t* result) {
+    static const uint64_t patterns[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    uint64_t* top = stack;
+    uint64_t* memo = stack + SLICE_WORDS * program->max_depth;
+    int i, w;
+    for (i = 0; i < program->size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_STORE || op == OP_LOAD) {
+            uint64_t* kept = memo + SLICE_WORDS * program->operands[i];
+            for (w = 0; w < SLICE_WORDS; w++) {
+                if (op == OP_STORE) {
+                    kept[w] = top[w - SLICE_WORDS];
+                }
+                else {
+                    top[w] = kept[w];
+                }
+            }
+            if (op == OP_LOAD) {
+                top += SLICE_WORDS;
+            }
+            continue;
+        }
+        if (op == OP_ATOM) {
+            int j = ass->index[program->operands[i]];
+            for (w = 0; w < SLICE_WORDS; w++) {
+                top[w] = j < 6 ? patterns[j] :
+                         -(((base + 64 * (uint64_t)w) >> j) & 1);
+            }
+            top += SLICE_WORDS;
+            continue;
+        }
+        if (op == OP_NOT) {
+            for (w = 0; w < SLICE_WORDS; w++) {
+                top[w - SLICE_WORDS] = ~top[w - SLICE_WORDS];
+            }
+            continue;
+        }
+        top -= SLICE_WORDS;
+        uint64_t* a = top - SLICE_WORDS;
+        uint64_t* b = top;
+        switch (op) {
+            case OP_AND:
+                for (w = 0; w < SLICE_WORDS; w++) {
+                    a[w] &= b[w];
+                }
+                break;
+            case OP_OR:
+                for (w = 0; w < SLICE_WORDS; w++) {
+                    a[w] |= b[w];
+                }
+                break;
+            case OP_IMPLIES:
+                for (w = 0; w < SLICE_WORDS; w++) {
+                    a[w] = ~a[w] | b[w];
+                }
+                break;
+            default:
+                for (w = 0; w < SLICE_WORDS; w++) {
+                    a[w] = ~(a[w] ^ b[w]);
+                }
+                break;
+        }
+    }
+    for (w = 0; w < SLICE_WORDS; w++) {
+        result[w] = stack[w];
+    }
+}
+
+/*
+ * Evaluate the program on the count words of worlds starting at word
+ * first, with a bitwise operation per instruction, and store the truth of
+ * the formula in each of those worlds in result. stack must have room for
+ * (max_depth + num_slots) * count words.
+ */
+SIMD_CLONES
+void eval_columns(PROGRAM* program, Worlds worlds, int first, int count,
+                  uint64_t* stack, uint64_t* result) {
+    uint64_t* top = stack;
+    uint64_t* memo = stack + (size_t)count * program->max_depth;
+    int i, w;
+    for (i = 0; i < program->size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_STORE || op == OP_LOAD) {
+            uint64_t* kept = memo + (size_t)count * program->operands[i];
+            for (w = 0; w < count; w++) {
+                if (op == OP_STORE) {
+                    kept[w] = top[w - count];
+                }
+                else {
+                    top[w] = kept[w];
+                }
+            }
+            if (op == OP_LOAD) {
+                top += count;
+            }
+            continue;
+        }
+        if (op == OP_ATOM) {
+            int atom = program->operands[i];
+            STAT_ADD(fact_lookups, count);
+            if (atom < worlds->num_atoms) {
+                uint64_t* row = worlds->rows + (size_t)atom * worlds->num_words + first;
+                for (w = 0; w < count; w++) {
+                    top[w] = row[w];
+                }
+            }
+            else {
+                for (w = 0; w < count; w++) {
+                    top[w] = 0;
+                }
+            }
+            top += count;
+            continue;
+        }
+        if (op == OP_NOT) {
+            for (w = 0; w < count; w++) {
+                top[w - count] = ~top[w - count];
+            }
+            continue;
+        }
+        top -= count;
+        uint64_t* a = top - count;
+        uint64_t* b = top;
+        switch (op) {
+            case OP_AND:
+                for (w = 0; w < count; w++) {
+                    a[w] &= b[w];
+                }
+                break;
+            case OP_OR:
+                for (w = 0; w < count; w++) {
+                    a[w] |= b[w];
+                }
+                break;
+            case OP_IMPLIES:
+                for (w = 0; w < count; w++) {
+                    a[w] = ~a[w] | b[w];
+                }
+                break;
+            default:
+                for (w = 0; w < count; w++) {
+                    a[w] = ~(a[w] ^ b[w]);
+                }
+                break;
+        }
+    }
+    for (w = 0; w < count; w++) {
+        result[w] = stack[w];
+    }
+}
+
+/*
+ * Return the next number with as many bits set as x (Gosper's hack).
+ */
+uint64_t next_same_popcount(uint64_t x) {
+    uint64_t lowest = x & -x;
+    uint64_t ripple = x + lowest;
+    return ripple | (((x ^ ripple) >> 2) / lowest);
+}
+
+/*
+ * Keep in best the satisfying assignment with the fewest true atoms, the
+ * lowest numbered one on ties, among those set in bits (assignments start
+ * to start + 63). Return the number of true atoms of best.
+ */
+int keep_best(uint64_t bits, uint64_t start, uint64_t* best, int best_count) {
+    while (bits != 0) {
+        uint64_t truth = start + __builtin_ctzll(bits);
+        int count = __builtin_popcountll(truth);
+        if (best_count == -1 || count < best_count ||
+            (count == best_count && truth < *best)) {
+            best_count = count;
+            *best = truth;
+        }
+        bits &= bits - 1;
+    }
+    return best_count;
+}
+
+/*
+ * Take the next slice for a worker of the sweep, from its own range or,
+ * once that is empty, by stealing the upper half of another worker's range.
+ * Return -1 when no slice is left.
+ */
+int take_slice(SWEEP* sweep, int id) {
+    WORK_RANGE* own = &sweep->ranges[id];
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end) {
+        int slice = own->next++;
+        pthread_mutex_unlock(&own->lock);
+        return slice;
+    }
+    pthread_mutex_unlock(&own->lock);
+    
+    int i;
+    for (i = 1; i < sweep->num_workers; i++) {
+        WORK_RANGE* victim = &sweep->ranges[(id + i) % sweep->num_workers];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->next;
+        if (left == 0) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        int middle = victim->next + left / 2;
+        int end = victim->end;
+        victim->end = middle;
+        pthread_mutex_unlock(&victim->lock);
+        
+        pthread_mutex_lock(&own->lock);
+        own->next = middle + 1;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return middle;
+    }
+    return -1;
+}
+
+/*
+ * Evaluate the slices of the current level of the sweep until none is
+ * left, merging the best assignment found into the sweep after each one.
+ * A slice is skipped when it cannot hold anything better than the best
+ * assignment found so far by any worker.
+ */
+void* sweep_worker(void* arg) {
+    WORKER* worker = arg;
+    SWEEP* sweep = worker->sweep;
+    PROGRAM* program = sweep->program;
+    uint64_t* stack = malloc(sizeof(uint64_t) * SLICE_WORDS *
+                             (program->max_depth + program->num_slots));
+    uint64_t result[SLICE_WORDS];
+    int slice, w;
+    while ((slice = take_slice(sweep, worker->id)) != -1) {
+        uint64_t base = sweep->slices[slice] << SLICE_BITS;
+        
+        /* The assignment with the fewest true atoms in the slice is base,
+         * which has level true atoms. */
+        pthread_mutex_lock(&sweep->best_lock);
+        uint64_t best = sweep->best;
+        int best_count = sweep->best_count;
+        pthread_mutex_unlock(&sweep->best_lock);
+        if (best_count != -1 && (best_count < sweep->level ||
+                                 (best_count == sweep->level && base > best))) {
+            continue;
+        }
+        
+        eval_slice(program, sweep->ass, base, stack, result);
+        for (w = 0; w < SLICE_WORDS; w++) {
+            uint64_t start = base + 64 * (uint64_t)w;
+            if (start >= sweep->total) {
+                break;
+            }
+            uint64_t bits = result[w];
+            if (sweep->total - start < 64) {
+                bits &= ((uint64_t)1 << (sweep->total - start)) - 1;
+            }
+            STAT_ADD_SHARED(assignments, sweep->total - start < 64 ? sweep->total - start : 64);
+            STAT_ADD_SHARED(witness_candidates, __builtin_popcountll(bits));
+            best_count = keep_best(bits, start, &best, best_count);
+        }
+        
+        if (best_count != -1) {
+            pthread_mutex_lock(&sweep->best_lock);
+            sweep->best_count = keep_best(1, best, &sweep->best, sweep->best_count);
+            pthread_mutex_unlock(&sweep->best_lock);
+        }
+    }
+    free(stack);
+    return NULL;
+}
+
+/*
+ * Search the assignments of the atoms of the program for a satisfying one
+ * with the fewest true atoms, the lowest numbered one on ties, and store it
+ * in witness. Return false if there is none.
+ *
+ * A slice covers all values of the low SLICE_BITS atoms for fixed values of
+ * the others. Slices are visited by increasing number of true high atoms,
+ * so the search stops as soon as that number exceeds the best count found:
+ * its cost depends on the size of the answer, not on 2^num_atoms.
+ *
+ * The slices of a level are split between the threads, which steal from
+ * each other when they run out. The best assignment is a minimum over a
+ * total order, so the witness does not depend on the number of threads.
+ */
+bool table_search(PROGRAM* program, assumption* ass, uint64_t* witness) {
+    int num_atoms = ass->num_atoms;
+    int num_high = num_atoms > SLICE_BITS ? num_atoms - SLICE_BITS : 0;
+    int max_workers = num_threads;
+    if (max_workers <= 0) {
+        max_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (max_workers > (1 << num_high)) {
+        max_workers = 1 << num_high;
+    }
+    if (max_workers < 1) {
+        max_workers = 1;
+    }
+    
+    SWEEP sweep;
+    sweep.program = program;
+    sweep.ass = ass;
+    sweep.total = (uint64_t)1 << num_atoms;
+    sweep.slices = malloc(sizeof(uint64_t) << num_high);
+    sweep.ranges = malloc(sizeof(WORK_RANGE) * max_workers);
+    sweep.best = 0;
+    sweep.best_count = -1;
+    pthread_mutex_init(&sweep.best_lock, NULL);
+    WORKER* workers = malloc(sizeof(WORKER) * max_workers);
+    pthread_t* threads = malloc(sizeof(pthread_t) * max_workers);
+    int i, k;
+    for (i = 0; i < max_workers; i++) {
+        pthread_mutex_init(&sweep.ranges[i].lock, NULL);
+        workers[i].sweep = &sweep;
+        workers[i].id = i;
+    }
+    
+    for (k = 0; k <= num_high; k++) {
+        if (sweep.best_count != -1 && k > sweep.best_count) {
+            break;
+        }
+        
+        /* 1. List the slices of the level, in increasing order. */
+        sweep.level = k;
+        sweep.num_slices = 0;
+        uint64_t high = ((uint64_t)1 << k) - 1;
+        while (high < ((uint64_t)1 << num_high)) {
+            sweep.slices[sweep.num_slices++] = high;
+            if (high == 0) {
+                break;
+            }
+            high = next_same_popcount(high);
+        }
+        
+        /* 2. Give each worker an equal share, and run them. */
+        sweep.num_workers = max_workers < sweep.num_slices ? max_workers
+                                                           : sweep.num_slices;
+        for (i = 0; i < sweep.num_workers; i++) {
+            sweep.ranges[i].next = (int)((int64_t)sweep.num_slices * i / sweep.num_workers);
+            sweep.ranges[i].end = (int)((int64_t)sweep.num_slices * (i + 1) / sweep.num_workers);
+        }
+        int started = 1;
+        for (i = 1; i < sweep.num_workers; i++) {
+            if (pthread_create(&threads[i], NULL, sweep_worker, &workers[i]) != 0) {
+                break;
+            }
+            started++;
+        }
+        /* Slices of threads that could not be started are stolen. */
+        sweep_worker(&workers[0]);
+        for (i = 1; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    
+    for (i = 0; i < max_workers; i++) {
+        pthread_mutex_destroy(&sweep.ranges[i].lock);
+    }
+    pthread_mutex_destroy(&sweep.best_lock);
+    free(threads);
+    free(workers);
+    free(sweep.ranges);
+    free(sweep.slices);
+    *witness = sweep.best;
+    return sweep.best_count != -1;
+}
+
+/*
+ * Keep the atoms of the assumption list that are in the witness as the
+ * last witness found, and write them to the witness file, one per line,
+ * unless witnesses are not written to file.
+ */
+void write_witnesses(assumption* ass, bool* in_witness) {
+    int i;
+    if (witness_atoms_capacity < ass->num_atoms) {
+        witness_atoms_capacity = ass->num_atoms;
+        witness_atoms = realloc(witness_atoms, sizeof(int) * witness_atoms_capacity);
+    }
+    num_witness_atoms = 0;
+    for (i = 0; i < ass->num_atoms; i++) {
+        if (in_witness[i]) {
+            witness_atoms[num_witness_atoms++] = ass->atoms[i];
+        }
+    }
+    if (!witness_to_file) {
+        return;
+    }
+    
+    FILE* file = fopen("witnesses_satisfiability.txt", "w");
+    for (i = 0; i < num_witness_atoms; i++) {
+        print_atom(file, witness_atoms[i]);
+        fputc('\n', file);
+    }
+    fclose(file);
+}
+
+/*
+ * Add a totalizer over the given literals to the solver, and return its
+ * outputs: outputs[j] is forced true as soon as at least j + 1 of the
+ * literals are true. Assuming the negation of outputs[j] therefore allows
+ * at most j of them to be true.
+ */
+int* add_totalizer(Solver solver, int* lits, int num_lits) {
+    int* outputs = malloc(sizeof(int) * num_lits);
+    if (num_lits == 1) {
+        outputs[0] = lits[0];
+        return outputs;
+    }
+    int half = num_lits / 2;
+    int* left = add_totalizer(solver, lits, half);
+    int* right = add_totalizer(solver, lits + half, num_lits - half);
+    int i, j;
+    for (i = 0; i < num_lits; i++) {
+        outputs[i] = sat_new_var(solver);
+    }
+    for (i = 0; i <= half; i++) {
+        for (j = 0; j <= num_lits - half; j++) {
+            if (i + j == 0) {
+                continue;
+            }
+            /* At least i on the left and j on the right. */
+            int clause[3];
+            int size = 0;
+            if (i > 0) {
+                clause[size++] = -left[i - 1];
+            }
+            if (j > 0) {
+                clause[size++] = -right[j - 1];
+            }
+            clause[size++] = outputs[i + j - 1];
+            sat_add_clause(solver, clause, size);
+        }
+    }
+    free(left);
+    free(right);
+    return outputs;
+}
+
+/*
+ * Find, from a model of the solver, a satisfying assignment with the fewest
+ * true atoms, and write it to the witness file.
+ *
+ * The search is core-guided (OLL): every atom is first assumed false. Each
+ * time the solver fails, the assumptions it failed on form a core, at least
+ * one of which must be given up, so the lower bound goes up by one and the
+ * core is replaced by a totalizer allowing one more of its members to be
+ * violated. The first model found under the assumptions has as many true
+ * atoms as the lower bound, so the number of calls to the solver depends
+ * on the size of the answer, not on the number of atoms.
+ */
+void make_witnesses_satisfiability(Solver solver, assumption* ass) {
+    int num_atoms = ass->num_atoms;
+    
+    int capacity = num_atoms + 1;
+    SOFT* softs = malloc(sizeof(SOFT) * capacity);
+    int* lits = malloc(sizeof(int) * capacity);
+    int* core = malloc(sizeof(int) * capacity);
+    SOFT* relaxed = malloc(sizeof(SOFT) * capacity);
+    int num_soft = 0;
+    int i;
+    
+    /* Totalizer outputs are kept in a list so that they can be freed. */
+    int** totalizers = NULL;
+    int num_totalizers = 0;
+    
+    for (i = 0; i < num_atoms; i++) {
+        softs[num_soft].lit = -(i + 1);
+        softs[num_soft].outputs = NULL;
+        lits[num_soft] = softs[num_soft].lit;
+        num_soft++;
+    }
+    
+    while (!sat_solve(solver, lits, num_soft)) {
+        STAT_ADD(solver_calls, 1);
+        
+        /* 1. Split the assumptions into the core and the others. */
+        int num_core = 0;
+        int num_kept = 0;
+        int num_relaxed = 0;
+        for (i = 0; i < num_soft; i++) {
+            SOFT soft = softs[i];
+            if (!sat_failed(solver, soft.lit)) {
+                softs[num_kept++] = soft;
+                continue;
+            }
+            core[num_core++] = -soft.lit;
+            
+            /* A bound that is given up is relaxed to the next one. */
+            if (soft.outputs != NULL && soft.bound + 1 < soft.size) {
+                soft.bound++;
+                soft.lit = -soft.outputs[soft.bound];
+                relaxed[num_relaxed++] = soft;
+            }
+        }
+        if (num_core == 0) {
+            /* The formula itself is unsatisfiable. */
+            break;
+        }
+        for (i = 0; i < num_relaxed; i++) {
+            softs[num_kept++] = relaxed[i];
+        }
+        
+        /* 2. Allow one of the members of the core to be violated. */
+        if (num_core > 1) {
+            int* outputs = add_totalizer(solver, core, num_core);
+            totalizers = realloc(totalizers, sizeof(int*) * (num_totalizers + 1));
+            totalizers[num_totalizers++] = outputs;
+            if (num_kept == capacity) {
+                capacity *= 2;
+                softs = realloc(softs, sizeof(SOFT) * capacity);
+                lits = realloc(lits, sizeof(int) * capacity);
+                core = realloc(core, sizeof(int) * capacity);
+                relaxed = realloc(relaxed, sizeof(SOFT) * capacity);
+            }
+            softs[num_kept].lit = -outputs[1];
+            softs[num_kept].outputs = outputs;
+            softs[num_kept].bound = 1;
+            softs[num_kept].size = num_core;
+            num_kept++;
+        }
+        
+        num_soft = num_kept;
+        for (i = 0; i < num_soft; i++) {
+            lits[i] = softs[i].lit;
+        }
+    }
+    
+    STAT_ADD(solver_calls, 1);
+    STAT_ADD(witness_candidates, 1);
+    bool* in_witness = malloc(sizeof(bool) * (num_atoms + 1));
+    for (i = 0; i < num_atoms; i++) {
+        in_witness[i] = sat_model_value(solver, i + 1);
+    }
+    write_witnesses(ass, in_witness);
+    
+    for (i = 0; i < num_totalizers; i++) {
+        free(totalizers[i]);
+    }
+    free(totalizers);
+    free(in_witness);
+    free(relaxed);
+    free(core);
+    free(lits);
+    free(softs);
+}
+
+/*
+ * Find the subformulas joined by and at the root of the program. start[i]
+ * is set to where the code of the subformula that ends at i starts,
+ * joins[i] to whether i is one of the and connectives that join them, and
+ * ends to where the code of each ends, in order. Return their number.
+ */
+int split_conjunction(PROGRAM* program, int* start, bool* joins, int* ends) {
+    int size = program->size;
+    int* stack = malloc(sizeof(int) * (size + 1));
+    int top = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+        uint8_t op = program->ops[i];
+        if (op == OP_ATOM || op == OP_LOAD) {
+            stack[top++] = i;
+        }
+        else if (op != OP_NOT && op != OP_STORE) {
+            top--;
+        }
+        start[i] = stack[top - 1];
+        joins[i] = false;
+    }
+    
+    /* Subformulas are met left to right. A stored one is not split, as
+     * its value is used elsewhere. */
+    int num_conjuncts = 0;
+    top = 0;
+    stack[top++] = size - 1;
+    while (top > 0) {
+        i = stack[--top];
+        if (program->ops[i] == OP_AND) {
+            joins[i] = true;
+            stack[top++] = i - 1;
+            stack[top++] = start[i - 1] - 1;
+        }
+        else {
+            ends[num_conjuncts++] = i;
+        }
+    }
+    free(stack);
+    return num_conjuncts;
+}
+
+/* A value to be sorted by key, then by value. */
+typedef struct {
+    double key;
+    int    value;
+} SORT_KEY;
+
+int compare_sort_keys(const void* a, const void* b) {
+    const SORT_KEY* x = a;
+    const SORT_KEY* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return x->value - y->value;
+}
+
+/*
+ * Breadth-first search of the atoms, where the neighbours of an atom are
+ * the other atoms of the conjuncts it is in, from start, numbering the
+ * atoms reached from num_reached in order, in var_of, and the conjuncts met
+ * in reached_conjunct, which are both updated. Return the last atom
+ * reached.
+ */
+int bfs_atoms(int start, const int* first, const int* atoms, const int* first_use,
+              const int* uses, int* var_of, int* queue, int* num_reached,
+              bool* reached_conjunct) {
+    int head = *num_reached;
+    int tail = head;
+    var_of[start] = tail;
+    queue[tail++] = start;
+    while (head < tail) {
+        int atom = queue[head++];
+        int i, k;
+        for (k = first_use[atom]; k < first_use[atom + 1]; k++) {
+            int j = uses[k];
+            if (reached_conjunct[j]) {
+                continue;
+            }
+            reached_conjunct[j] = true;
+            for (i = first[j]; i < first[j + 1]; i++) {
+                if (var_of[atoms[i]] == -1) {
+                    var_of[atoms[i]] = tail;
+                    queue[tail++] = atoms[i];
+                }
+            }
+        }
+    }
+    *num_reached = tail;
+    return queue[tail - 1];
+}
+
+/*
+ * Number the atoms, in var_of, by breadth-first search from an atom of
+ * each connected part, in the order of var_of, chosen by a first search
+ * as the one farthest from that atom. The atoms of conjunct j are atoms
+ * first[j] to first[j + 1] - 1.
+ */
+void bfs_order(int num_atoms, int num_conjuncts, const int* first, const int* atoms,
+               int* var_of) {
+    int num_entries = first[num_conjuncts];
+    int* first_use = calloc(sizeof(int), num_atoms + 1);
+    int* uses = malloc(sizeof(int) * (num_entries + 1));
+    int* by_var = malloc(sizeof(int) * (num_atoms + 1));
+    int* queue = malloc(sizeof(int) * (num_atoms + 1));
+    int* trial = malloc(sizeof(int) * (num_atoms + 1));
+    bool* reached_conjunct = calloc(sizeof(bool), num_conjuncts);
+    bool* trial_conjunct = calloc(sizeof(bool), num_conjuncts);
+    int i, j;
+    for (i = 0; i < num_entries; i++) {
+        first_use[atoms[i] + 1]++;
+    }
+    for (i = 0; i < num_atoms; i++) {
+        first_use[i + 1] += first_use[i];
+    }
+    for (j = 0; j < num_conjuncts; j++) {
+        for (i = first[j]; i < first[j + 1]; i++) {
+            uses[first_use[atoms[i]]++] = j;
+        }
+    }
+    for (i = num_atoms; i > 0; i--) {
+        first_use[i] = first_use[i - 1];
+    }
+    first_use[0] = 0;
+    for (i = 0; i < num_atoms; i++) {
+        by_var[var_of[i]] = i;
+        var_of[i] = -1;
+        trial[i] = -1;
+    }
+    
+    int num_reached = 0;
+    for (i = 0; i < num_atoms; i++) {
+        int atom = by_var[i];
+        if (var_of[atom] != -1) {
+            continue;
+        }
+        /* The trial search numbers the same part from the same place. */
+        int num_tried = num_reached;
+        int far = bfs_atoms(atom, first, atoms, first_use, uses, trial, queue,
+                            &num_tried, trial_conjunct);
+        bfs_atoms(far, first, atoms, first_use, uses, var_of, queue,
+                  &num_reached, reached_conjunct);
+    }
+    free(trial_conjunct);
+    free(reached_conjunct);
+    free(trial);
+    free(queue);
+    free(by_var);
+    free(uses);
+    free(first_use);
+}
+
+/*
+ * Give each atom of the assumption list a BDD variable, in var_of.
+ *
+ * The atoms are ordered by a depth-first walk of the formula that visits
+ * the larger operand of each connective first, so that atoms that occur
+ * together are close. When the formula is a conjunction, they are ordered
+ * instead by a breadth-first search through the conjuncts, and the order
+ * is then improved by moving each atom to the average of the centres of
+ * the conjuncts it occurs in, and the centres to the average of their
+ * atoms, as long as that brings the atoms of each conjunct closer.
+ */
+void order_bdd_vars(PROGRAM* program, assumption* ass, const int* start,
+                    const int* ends, int num_conjuncts, int* var_of) {
+    int size = program->size;
+    int num_atoms = ass->num_atoms;
+    int* stored = malloc(sizeof(int) * (program->num_slots + 1));
+    bool* visited = calloc(sizeof(bool), program->num_slots + 1);
+    int* stack = malloc(sizeof(int) * (size + 1));
+    int top = 0;
+    int i, j;
+    for (i = 0; i < size; i++) {
+        if (program->ops[i] == OP_STORE) {
+            stored[program->operands[i]] = i - 1;
+        }
+    }
+    for (i = 0; i < num_atoms; i++) {
+        var_of[i] = -1;
+    }
+    int num_vars = 0;
+    stack[top++] = size - 1;
+    while (top > 0) {
+        i = stack[--top];
+        uint8_t op = program->ops[i];
+        int slot = program->operands[i];
+        if (op == OP_ATOM) {
+            if (var_of[ass->index[slot]] == -1) {
+                var_of[ass->index[slot]] = num_vars++;
+            }
+        }
+        else if (op == OP_LOAD || op == OP_STORE) {
+            if (!visited[slot]) {
+                visited[slot] = true;
+                stack[top++] = stored[slot];
+            }
+        }
+        else if (op == OP_NOT) {
+            stack[top++] = i - 1;
+        }
+        else {
+            int b = i - 1;
+            int a = start[b] - 1;
+            if (b - start[b] > a - start[a]) {
+                stack[top++] = a;
+                stack[top++] = b;
+            }
+            else {
+                stack[top++] = b;
+                stack[top++] = a;
+            }
+        }
+    }
+    free(visited);
+    if (num_conjuncts < 2) {
+        free(stack);
+        free(stored);
+        return;
+    }
+    
+    /* 1. List the atoms of each conjunct, following the loads. */
+    int* first = malloc(sizeof(int) * (num_conjuncts + 1));
+    int capacity = size + 1;
+    int* atoms = malloc(sizeof(int) * capacity);
+    int* last_seen = malloc(sizeof(int) * (num_atoms + 1));
+    int* slot_seen = malloc(sizeof(int) * (program->num_slots + 1));
+    int num_entries = 0;
+    for (i = 0; i < num_atoms; i++) {
+        last_seen[i] = -1;
+    }
+    for (i = 0; i < program->num_slots; i++) {
+        slot_seen[i] = -1;
+    }
+    for (j = 0; j < num_conjuncts; j++) {
+        first[j] = num_entries;
+        stack[top++] = ends[j];
+        while (top > 0) {
+            i = stack[--top];
+            uint8_t op = program->ops[i];
+            int operand = program->operands[i];
+            if (op == OP_ATOM) {
+                int atom = ass->index[operand];
+                if (last_seen[atom] != j) {
+                    last_seen[atom] = j;
+                    if (num_entries == capacity) {
+                        capacity *= 2;
+                        atoms = realloc(atoms, sizeof(int) * capacity);
+                    }
+                    atoms[num_entries++] = atom;
+                }
+            }
+            else if (op == OP_LOAD || op == OP_STORE) {
+                if (slot_seen[operand] != j) {
+                    slot_seen[operand] = j;
+                    stack[top++] = stored[operand];
+                }
+            }
+            else {
+                stack[top++] = i - 1;
+                if (op != OP_NOT) {
+                    stack[top++] = start[i - 1] - 1;
+                }
+            }
+        }
+    }
+    first[num_conjuncts] = num_entries;
+    free(slot_seen);
+    free(stack);
+    free(stored);
+    
+    /* 2. Start again from an order by breadth-first search, from an atom
+     *    that is as far as can be found from the first one, so that atoms
+     *    of the same conjunct are close when the conjuncts form a chain. */
+    bfs_order(num_atoms, num_conjuncts, first, atoms, var_of);
+    
+    /* 3. Move the atoms and the centres in turn, keeping the order with the
+     *    smallest total span of the conjuncts. */
+    double* centre = malloc(sizeof(double) * num_conjuncts);
+    double* sum = malloc(sizeof(double) * num_atoms);
+    int* degree = malloc(sizeof(int) * num_atoms);
+    SORT_KEY* keys = malloc(sizeof(SORT_KEY) * num_atoms);
+    int* best = malloc(sizeof(int) * num_atoms);
+    memcpy(best, var_of, sizeof(int) * num_atoms);
+    int64_t best_span = -1;
+    int round;
+    for (round = 0; round < BDD_ORDER_ROUNDS; round++) {
+        int64_t span = 0;
+        for (j = 0; j < num_conjuncts; j++) {
+            int low = num_atoms;
+            int high = 0;
+            double total = 0;
+            for (i = first[j]; i < first[j + 1]; i++) {
+                int var = var_of[atoms[i]];
+                total += var;
+                low = var < low ? var : low;
+                high = var > high ? var : high;
+            }
+            if (first[j + 1] > first[j]) {
+                centre[j] = total / (first[j + 1] - first[j]);
+                span += high - low;
+            }
+        }
+        if (best_span != -1 && span >= best_span) {
+            break;
+        }
+        best_span = span;
+        memcpy(best, var_of, sizeof(int) * num_atoms);
+        
+        for (i = 0; i < num_atoms; i++) {
+            sum[i] = 0;
+            degree[i] = 0;
+        }
+        for (j = 0; j < num_conjuncts; j++) {
+            for (i = first[j]; i < first[j + 1]; i++) {
+                sum[atoms[i]] += centre[j];
+                degree[atoms[i]]++;
+            }
+        }
+        for (i = 0; i < num_atoms; i++) {
+            keys[i].key = degree[i] > 0 ? sum[i] / degree[i] : var_of[i];
+            keys[i].value = i;
+        }
+        qsort(keys, num_atoms, sizeof(SORT_KEY), compare_sort_keys);
+        for (i = 0; i < num_atoms; i++) {
+            var_of[keys[i].value] = i;
+        }
+    }
+    memcpy(var_of, best, sizeof(int) * num_atoms);
+    free(best);
+    free(keys);
+    free(degree);
+    free(sum);
+    free(centre);
+    free(last_seen);
+    free(atoms);
+    free(first);
+}
+
+/*
+ * Build the BDD of the program in a new manager, with the atoms given
+ * variables by order_bdd_vars(), set in var_of. The conjuncts at the root
+ * are built separately, then joined from the one with the deepest top
+ * variable up, so that each and only meets the part of the BDD made so
+ * far that it shares atoms with. Return the root, referenced, or -1 if
+ * the BDD grows beyond max_nodes.
+ */
+int build_bdd(PROGRAM* program, assumption* ass, int* var_of, int max_nodes,
+              BddManager* bdd_ptr) {
+    int size = program->size;
+    int* start = malloc(sizeof(int) * (size + 1));
+    bool* joins = malloc(sizeof(bool) * (size + 1));
+    int* ends = malloc(sizeof(int) * (size + 1));
+    int num_conjuncts = split_conjunction(program, start, joins, ends);
+    order_bdd_vars(program, ass, start, ends, num_conjuncts, var_of);
+    free(ends);
+    free(start);
+    BddManager bdd = bdd_new(ass->num_atoms, max_nodes);
+    bdd_set_reordering(bdd, bdd_sifting);
+    *bdd_ptr = bdd;
+    
+    /* 1. Run the program, leaving the conjuncts on the stack. */
+    int* stack = malloc(sizeof(int) * (program->max_depth + num_conjuncts + program->num_slots));
+    int* memo = stack + program->max_depth + num_conjuncts;
+    int top = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+        uint8_t op = program->ops[i];
+        int r;
+        if (joins[i]) {
+            continue;
+        }
+        else if (op == OP_STORE) {
+            memo[program->operands[i]] = bdd_ref(bdd, stack[top - 1]);
+            continue;
+        }
+        else if (op == OP_LOAD) {
+            stack[top++] = bdd_ref(bdd, memo[program->operands[i]]);
+            continue;
+        }
+        else if (op == OP_ATOM) {
+            r = bdd_var(bdd, var_of[ass->index[program->operands[i]]]);
+            if (r < 0) {
+                break;
+            }
+            stack[top++] = bdd_ref(bdd, r);
+            continue;
+        }
+        else if (op == OP_NOT) {
+            r = bdd_not(bdd, stack[top - 1]);
+            if (r < 0) {
+                break;
+            }
+            bdd_deref(bdd, stack[top - 1]);
+            stack[top - 1] = bdd_ref(bdd, r);
+            continue;
+        }
+        
+        int b = stack[--top];
+        int a = stack[top - 1];
+        if (op == OP_AND) {
+            r = bdd_and(bdd, a, b);
+        }
+        else if (op == OP_OR) {
+            r = bdd_or(bdd, a, b);
+        }
+        else if (op == OP_IMPLIES) {
+            r = bdd_implies(bdd, a, b);
+        }
+        else {
+            r = bdd_iff(bdd, a, b);
+        }
+        if (r < 0) {
+            break;
+        }
+        bdd_deref(bdd, a);
+        bdd_deref(bdd, b);
+        stack[top - 1] = bdd_ref(bdd, r);
+    }
+    free(joins);
+    
+    /* 2. Join the conjuncts. When the BDD is too large, the nodes still
+     *    referenced are freed with the manager. */
+    int root = -1;
+    if (i == size) {
+        for (i = 0; i < program->num_slots; i++) {
+            bdd_deref(bdd, memo[i]);
+        }
+        SORT_KEY* keys = malloc(sizeof(SORT_KEY) * num_conjuncts);
+        for (i = 0; i < num_conjuncts; i++) {
+            keys[i].key = -bdd_level(bdd, stack[i]);
+            keys[i].value = stack[i];
+        }
+        qsort(keys, num_conjuncts, sizeof(SORT_KEY), compare_sort_keys);
+        root = BDD_TRUE;
+        for (i = 0; i < num_conjuncts; i++) {
+            int r = root < 0 ? -1 : bdd_and(bdd, root, keys[i].value);
+            bdd_deref(bdd, keys[i].value);
+            if (root >= 0) {
+                bdd_deref(bdd, root);
+            }
+            root = r < 0 ? -1 : bdd_ref(bdd, r);
+        }
+        free(keys);
+    }
+    free(stack);
+    return root;
+}
+
+/*
+ * Decide the program with a BDD and write the witness, as table_search()
+ * finds it: the satisfying assignment with the fewest true atoms, the
+ * lowest numbered one on ties. Return 1 if the program is satisfiable, 0
+ * if not, and -1 if the BDD grows beyond the node limit, which scales with
+ * the size of the program.
+ */
+int bdd_search(PROGRAM* program, assumption* ass) {
+    int num_atoms = ass->num_atoms;
+    int* var_of = malloc(sizeof(int) * (num_atoms + 1));
+    BddManager bdd;
+    int max_nodes = BDD_MAX_NODES / BDD_NODES_PER_OP > program->size ?
+                    BDD_NODES_PER_OP * program->size : BDD_MAX_NODES;
+    if (max_nodes < BDD_MIN_NODES) {
+        max_nodes = BDD_MIN_NODES;
+    }
+    int root = build_bdd(program, ass, var_of, max_nodes, &bdd);
+    int result = root < 0 ? -1 : root != BDD_FALSE;
+    
+    /* The assignment numbers atoms from the first, so making the last atoms
+     * false comes first. */
+    if (result == 1) {
+        int* priority = malloc(sizeof(int) * (num_atoms + 1));
+        bool* values = malloc(sizeof(bool) * (num_atoms + 1));
+        int i;
+        for (i = 0; i < num_atoms; i++) {
+            priority[i] = var_of[num_atoms - 1 - i];
+        }
+        bdd_min_model(bdd, root, priority, values);
+        bool* in_witness = malloc(sizeof(bool) * (num_atoms + 1));
+        for (i = 0; i < num_atoms; i++) {
+            in_witness[i] = values[var_of[i]];
+        }
+        STAT_ADD(witness_candidates, 1);
+        write_witnesses(ass, in_witness);
+        free(in_witness);
+        free(values);
+        free(priority);
+    }
+    bdd_free(bdd);
+    free(var_of);
+    return result;
+}
+
+/*
+ * Give a variable to the atoms of the program that have none yet, count a
+ * use of each occurrence, listing it in used, and add the clauses of the
+ * program to the knowledge base with the guard. Return the literal
+ * equivalent to the program.
+ */
+int encode_in_base(knowledge_base* kb, PROGRAM* program, int guard) {
+    int i;
+    if (kb->atom_capacity < num_ground_atoms + 1) {
+        int capacity = 2 * (num_ground_atoms + 1);
+        kb->ass.atoms = realloc(kb->ass.atoms, sizeof(int) * capacity);
+        kb->ass.index = realloc(kb->ass.index, sizeof(int) * capacity);
+        kb->uses = realloc(kb->uses, sizeof(int) * capacity);
+        for (i = kb->atom_capacity; i < capacity; i++) {
+            kb->ass.index[i] = -1;
+        }
+        kb->atom_capacity = capacity;
+    }
+    for (i = 0; i < program->size; i++) {
+        if (program->ops[i] != OP_ATOM) {
+            continue;
+        }
+        int atom = program->operands[i];
+        if (kb->ass.index[atom] == -1) {
+            kb->ass.index[atom] = sat_new_var(kb->solver) - 1;
+            kb->ass.atoms[kb->ass.num_atoms++] = atom;
+            kb->uses[atom] = 0;
+        }
+        kb->uses[atom]++;
+        if (kb->num_used == kb->used_capacity) {
+            kb->used_capacity = kb->used_capacity == 0 ? 256 : 2 * kb->used_capacity;
+            kb->used = realloc(kb->used, sizeof(int) * kb->used_capacity);
+        }
+        kb->used[kb->num_used++] = atom;
+    }
+    int num_vars = sat_num_vars(kb->solver);
+    CLAUSES clauses = {kb->solver, NULL, guard};
+    int root = tseitin_encode(program, &kb->ass, &clauses);
+    kb->num_live += sat_num_vars(kb->solver) - num_vars;
+    return root;
+}
+
+/*
+ * Take back the clauses with the guard, by making it false for good, and
+ * the uses of atoms listed from first_used on. The connectives made since
+ * the knowledge base had num_live of them are retired, and the clauses
+ * retired are deleted once there are enough of them.
+ */
+void retire(knowledge_base* kb, int guard, int first_used, int num_live) {
+    int lit = -guard;
+    sat_add_clause(kb->solver, &lit, 1);
+    while (kb->num_used > first_used) {
+        kb->uses[kb->used[--kb->num_used]]--;
+    }
+    kb->num_retired += kb->num_live - num_live;
+    kb->num_live = num_live;
+    if (kb->num_retired >= KB_MIN_RETIRED && kb->num_retired > kb->num_live) {
+        sat_simplify(kb->solver);
+        kb->num_retired = 0;
+    }
+}
+
+/*
+ * Give the interpretation room for all atoms interned so far; new atoms
+ * are false.
+ */
+void grow_interpretation(Interpretation interp) {
+    int old_words = interp->num_atoms / 64 + 1;
+    int new_words = num_ground_atoms / 64 + 1;
+    if (new_words > old_words) {
+        interp->truth = realloc(interp->truth, sizeof(uint64_t) * new_words);
+        memset(interp->truth + old_words, 0, sizeof(uint64_t) * (new_words - old_words));
+    }
+    interp->num_atoms = num_ground_atoms;
+}
+
+/*
+ * Compute the value of a node of the evaluation from the values of its
+ * subformulas, or of its atom for a leaf.
+ */
+bool node_value(evaluation* eval, int id) {
+    Formula f = eval->nodes[id];
+    Interpretation interp = eval->interp;
+    bool a = f->sub_f1 != NULL && eval->values[f->sub_f1->id];
+    bool b = f->sub_f2 != NULL && eval->values[f->sub_f2->id];
+    switch (eval->ops[id]) {
+        case OP_ATOM:
+            return f->atom < interp->num_atoms &&
+                   (interp->truth[f->atom / 64] >> (f->atom % 64) & 1) == 1;
+        case OP_NOT:
+            return !a;
+        case OP_AND:
+            return a && b;
+        case OP_OR:
+            return a || b;
+        case OP_IMPLIES:
+            return !a || b;
+        default:
+            return a == b;
+    }
+}
+
+/*
+ * Queue the parents of a node that are not queued yet, keeping the heap
+ * ordered by id.
+ */
+void queue_parents(evaluation* eval, int id) {
+    int k;
+    for (k = eval->first_parent[id]; k < eval->first_parent[id + 1]; k++) {
+        int parent = eval->parents[k];
+        if (eval->queued[parent]) {
+            continue;
+        }
+        eval->queued[parent] = true;
+        int i = eval->heap_size++;
+        while (i > 0 && eval->heap[(i - 1) / 2] > parent) {
+            eval->heap[i] = eval->heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        eval->heap[i] = parent;
+    }
+}
+
+int unqueue_first(evaluation* eval) {
+    int first = eval->heap[0];
+    int last = eval->heap[--eval->heap_size];
+    int i = 0;
+    while (2 * i + 1 < eval->heap_size) {
+        int child = 2 * i + 1;
+        if (child + 1 < eval->heap_size && eval->heap[child + 1] < eval->heap[child]) {
+            child++;
+        }
+        if (eval->heap[child] > last) {
+            break;
+        }
+        eval->heap[i] = eval->heap[child];
+        i = child;
+    }
+    eval->heap[i] = last;
+    eval->queued[first] = false;
+    return first;
+}
+
+/*
+ * The value of the leaf has changed: evaluate again the nodes above it, by
+ * increasing id so that a node comes after all of its subformulas, and
+ * going up only from those whose value changes.
+ */
+void propagate(evaluation* eval, int leaf) {
+    eval->values[leaf] = !eval->values[leaf];
+    queue_parents(eval, leaf);
+    while (eval->heap_size > 0) {
+        int id = unqueue_first(eval);
+        bool value = node_value(eval, id);
+        if (value != eval->values[id]) {
+            eval->values[id] = value;
+            queue_parents(eval, id);
+        }
+    }
+}
+
+/*
+ * Make the atom with the given ID true or false in the interpretation.
+ * Return true if its value changes.
+ */
+bool set_atom(Interpretation interp, int id, bool value) {
+    if (id >= interp->num_atoms) {
+        grow_interpretation(interp);
+    }
+    uint64_t bit = (uint64_t)1 << (id % 64);
+    if (((interp->truth[id / 64] & bit) != 0) == value) {
+        return false;
+    }
+    interp->truth[id / 64] ^= bit;
+    return true;
+}
+
+/*
+ * Make an atom true or false in the interpretation of the evaluation, and
+ * bring the evaluation up to date. The leaf is compared with the value
+ * rather than with the bit, so that evaluations sharing an interpretation
+ * each catch up when the fact is set through them. Return false if the
+ * text is not an atom.
+ */
+bool set_evaluation_fact(evaluation* eval, const char* atom, bool value) {
+    int id = resolve_atom(atom, strlen(atom));
+    if (id == -1) {
+        return false;
+    }
+    set_atom(eval->interp, id, value);
+    if (id < eval->num_atoms && eval->leaves[id] != -1 &&
+        eval->values[eval->leaves[id]] != value) {
+        propagate(eval, eval->leaves[id]);
+    }
+    return true;
+}
+
+/*
+ * FNV-1a hash of the names and predicates, with their arities, in the
+ * order they were read: atoms are stored in files by the indexes of their
+ * predicate and names, which only mean the same with the same vocabulary.
+ */
+uint64_t vocabulary_fingerprint() {
+    uint64_t h = 14695981039346656037ULL;
+    int i;
+    const char* c;
+    for (i = 0; i < num_names; i++) {
+        for (c = names[i]; ; c++) {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0') {
+                break;
+            }
+        }
+    }
+    for (i = 0; i < num_predicates; i++) {
+        for (c = predicates[i].name; ; c++) {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0') {
+                break;
+            }
+        }
+        h = (h ^ (uint64_t)predicates[i].arity) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * Check that code read from a file can be run: its opcodes and operands
+ * are in range, each slot is stored once before it is loaded, and it never
+ * pops more than it has pushed nor pushes more than max_depth values,
+ * leaving one.
+ */
+bool is_valid_code(PROGRAM* program, int num_atoms) {
+    /* Each slot takes a store, so there are no more slots than instructions. */
+    if (program->num_slots > program->size) {
+        return false;
+    }
+    bool* stored = calloc(sizeof(bool), program->num_slots + 1);
+    bool valid = true;
+    int depth = 0;
+    int i;
+    for (i = 0; valid && i < program->size; i++) {
+        int32_t operand = program->operands[i];
+        switch (program->ops[i]) {
+            case OP_ATOM:
+                if (operand < 0 || operand >= num_atoms) {
+                    valid = false;
+                }
+                depth++;
+                break;
+            case OP_LOAD:
+                if (operand < 0 || operand >= program->num_slots || !stored[operand]) {
+                    valid = false;
+                }
+                depth++;
+                break;
+            case OP_STORE:
+                if (operand < 0 || operand >= program->num_slots || stored[operand] ||
+                    depth < 1) {
+                    valid = false;
+                    break;
+                }
+                stored[operand] = true;
+                break;
+            case OP_NOT:
+                if (depth < 1) {
+                    valid = false;
+                }
+                break;
+            case OP_AND:
+            case OP_OR:
+            case OP_IMPLIES:
+            case OP_IFF:
+                if (depth < 2) {
+                    valid = false;
+                }
+                depth--;
+                break;
+            default:
+                valid = false;
+        }
+        if (depth > program->max_depth) {
+            valid = false;
+        }
+    }
+    free(stored);
+    return valid && depth == 1;
+}
+
+/*
+ * Return the nodes of a formula by id, NULL for ids that are not in it, and
+ * store their number in num_nodes.
+ */
+Formula* collect_nodes(Formula formula, int* num_nodes) {
+    int n = formula->id + 1;
+    Formula* nodes = calloc(sizeof(Formula), n);
+    int* stack = malloc(sizeof(int) * n);
+    int top = 0;
+    int k;
+    stack[top++] = formula->id;
+    nodes[formula->id] = formula;
+    *num_nodes = 1;
+    while (top > 0) {
+        Formula f = nodes[stack[--top]];
+        Formula subs[2] = {f->sub_f1, f->sub_f2};
+        for (k = 0; k < f->arity; k++) {
+            if (nodes[subs[k]->id] == NULL) {
+                nodes[subs[k]->id] = subs[k];
+                stack[top++] = subs[k]->id;
+                (*num_nodes)++;
+            }
+        }
+    }
+    free(stack);
+    return nodes;
+}
+
+/*
+ * Return the node with the given connective, and, or or iff, and
+ * subformulas, which are put in order of id so that both orders give the
+ * same node.
+ */
+Formula make_junction(NODE_TABLE* table, uint8_t op, Formula a, Formula b) {
+    if (b->id < a->id) {
+        Formula c = a;
+        a = b;
+        b = c;
+    }
+    const char* word = op == OP_AND ? "and" : op == OP_OR ? "or" : "iff";
+    return make_node(table, 2, word, strlen(word), -1, a, b);
+}
+
+bool is_junction(Formula f, uint8_t op) {
+    return f->arity == 2 && node_opcode(f) == op;
+}
+
+/*
+ * Return a simplified node for a and b, or a or b, given by op, where na
+ * and nb are the negations of a and b, or NULL if not known. Constants are
+ * folded, and repeated, complementary and absorbed operands removed.
+ */
+Formula rewrite_junction(NODE_TABLE* table, uint8_t op, Formula a, Formula na,
+                         Formula b, Formula nb) {
+    Formula settling = op == OP_AND ? FALSE_NODE : TRUE_NODE;
+    Formula neutral = op == OP_AND ? TRUE_NODE : FALSE_NODE;
+    uint8_t dual = op == OP_AND ? OP_OR : OP_AND;
+    int k;
+    for (k = 0; k < 2; k++) {
+        if (a == settling) {
+            return settling;
+        }
+        if (a == neutral || a == b) {
+            return b;
+        }
+        if (na != NULL && na == b) {
+            return settling;
+        }
+        if (is_junction(b, op)) {
+            /* a and [a and c] is [a and c]; a and [not a and c] is false. */
+            if (b->sub_f1 == a || b->sub_f2 == a) {
+                return b;
+            }
+            if (na != NULL && (b->sub_f1 == na || b->sub_f2 == na)) {
+                return settling;
+            }
+        }
+        if (is_junction(b, dual)) {
+            /* a and [a or c] is a; a and [not a or c] is a and c. */
+            if (b->sub_f1 == a || b->sub_f2 == a) {
+                return a;
+            }
+            if (na != NULL && (b->sub_f1 == na || b->sub_f2 == na)) {
+                return make_junction(table, op, a, b->sub_f1 == na ? b->sub_f2 : b->sub_f1);
+            }
+        }
+        Formula c = a;
+        a = b;
+        b = c;
+        c = na;
+        na = nb;
+        nb = c;
+    }
+    return make_junction(table, op, a, b);
+}
+
+/*
+ * Return a simplified node for a iff b, where na and nb are the negations
+ * of a and b.
+ */
+Formula rewrite_iff(NODE_TABLE* table, Formula a, Formula na, Formula b, Formula nb) {
+    if (a == TRUE_NODE || b == TRUE_NODE) {
+        return a == TRUE_NODE ? b : a;
+    }
+    if (a == FALSE_NODE || b == FALSE_NODE) {
+        return a == FALSE_NODE ? nb : na;
+    }
+    if (a == b) {
+        return TRUE_NODE;
+    }
+    if (a == nb) {
+        return FALSE_NODE;
+    }
+    return make_junction(table, OP_IFF, a, b);
+}
+
+/*
+ * Count the parents of the nodes of a formula again, from those in it
+ * only: make_node() also counts the parents that were made but are not
+ * used, which would make code store and load nodes that have one parent.
+ */
+void recount_refs(Formula formula) {
+    int num_nodes;
+    Formula* nodes = collect_nodes(formula, &num_nodes);
+    int i;
+    for (i = 0; i <= formula->id; i++) {
+        if (nodes[i] != NULL) {
+            nodes[i]->refs = 0;
+        }
+    }
+    for (i = 0; i <= formula->id; i++) {
+        if (nodes[i] != NULL && nodes[i]->sub_f1 != NULL) {
+            nodes[i]->sub_f1->refs++;
+            if (nodes[i]->sub_f2 != NULL) {
+                nodes[i]->sub_f2->refs++;
+            }
+        }
+    }
+    free(nodes);
+}
+
+/*
+ * Rewrite a formula into negation normal form, where negations are only
+ * applied to atoms and iff is kept, in the arena, simplifying each node
+ * once its subformulas are. Both the node and its negation are
+ * made, subformulas first, so that no recursion is needed. Atoms true in
+ * known_true or in known_false, if given, are replaced by true or false.
+ * Return the new root, which may be TRUE_NODE or FALSE_NODE.
+ */
+Formula simplify_pass(Formula formula, ARENA* arena, Interpretation known_true,
+                      Interpretation known_false) {
+    int n = formula->id + 1;
+    int num_nodes;
+    Formula* nodes = collect_nodes(formula, &num_nodes);
+    Formula* pos = malloc(sizeof(Formula) * n);
+    Formula* neg = malloc(sizeof(Formula) * n);
+    NODE_TABLE table = {arena, NULL, 0, 0};
+    int i;
+    for (i = 0; i < n; i++) {
+        Formula f = nodes[i];
+        if (f == NULL) {
+            continue;
+        }
+        if (f->arity == 0) {
+            int atom = f->atom;
+            if (known_true != NULL && atom < known_true->num_atoms &&
+                (known_true->truth[atom / 64] >> (atom % 64) & 1) == 1) {
+                pos[i] = TRUE_NODE;
+                neg[i] = FALSE_NODE;
+            }
+            else if (known_false != NULL && atom < known_false->num_atoms &&
+                     (known_false->truth[atom / 64] >> (atom % 64) & 1) == 1) {
+                pos[i] = FALSE_NODE;
+                neg[i] = TRUE_NODE;
+            }
+            else {
+                pos[i] = make_node(&table, 0, "", 0, atom, NULL, NULL);
+                neg[i] = make_node(&table, 1, "not", 3, -1, pos[i], NULL);
+            }
+            continue;
+        }
+        int a = f->sub_f1->id;
+        if (f->arity == 1) {
+            pos[i] = neg[a];
+            neg[i] = pos[a];
+            continue;
+        }
+        int b = f->sub_f2->id;
+        switch (node_opcode(f)) {
+            case OP_AND:
+                pos[i] = rewrite_junction(&table, OP_AND, pos[a], neg[a], pos[b], neg[b]);
+                neg[i] = rewrite_junction(&table, OP_OR, neg[a], pos[a], neg[b], pos[b]);
+                break;
+            case OP_OR:
+                pos[i] = rewrite_junction(&table, OP_OR, pos[a], neg[a], pos[b], neg[b]);
+                neg[i] = rewrite_junction(&table, OP_AND, neg[a], pos[a], neg[b], pos[b]);
+                break;
+            case OP_IMPLIES:
+                pos[i] = rewrite_junction(&table, OP_OR, neg[a], pos[a], pos[b], neg[b]);
+                neg[i] = rewrite_junction(&table, OP_AND, pos[a], neg[a], neg[b], pos[b]);
+                break;
+            default:
+                /* iff is kept, as expanding it would double its operands;
+                 * not [a iff b] is [a iff not b]. */
+                pos[i] = rewrite_iff(&table, pos[a], neg[a], pos[b], neg[b]);
+                neg[i] = rewrite_iff(&table, pos[a], neg[a], neg[b], pos[b]);
+                break;
+        }
+    }
+    Formula root = pos[formula->id];
+    free(table.slots);
+    free(neg);
+    free(pos);
+    free(nodes);
+    if (root != TRUE_NODE && root != FALSE_NODE) {
+        recount_refs(root);
+    }
+    return root;
+}
+
+/* ==================== Functions Implemented =====================*/
+
+void get_constants(FILE *file) {
+    STAT_START(PHASE_LOAD);
+    
+    /* 1. Initialize the names table; it grows as needed. */
+    symbol_table_init(&name_table, 16);
+    
+    /* 2. Map the file and intern the words. */
+    FILE_VIEW view;
+    if (view_open(file, &view)) {
+        size_t pos = 0;
+        const char* word;
+        int len;
+        while (next_word(&view, &pos, &word, &len)) {
+            symbol_add(&name_table, word, len);
+        }
+        view_close(&view);
+    }
+    
+    /* 3. The arena no longer moves, so the names can point into it. */
+    num_names = name_table.num_strings;
+    names = calloc(sizeof(char*), num_names + 1);
+    int i;
+    for (i = 0; i < num_names; i++) {
+        names[i] = symbol_string(&name_table, i);
+    }
+    STAT_STOP(PHASE_LOAD);
+}
+
+void get_predicates(FILE *file) {
+    STAT_START(PHASE_LOAD);
+    
+    /* 1. Initialize the predicates table; it grows as needed. */
+    symbol_table_init(&predicate_table, 16);
+    
+    /* 2. Map the file and save the words as predicates. */
+    FILE_VIEW view;
+    if (view_open(file, &view)) {
+        size_t pos = 0;
+        const char* word;
+        int len;
+        while (next_word(&view, &pos, &word, &len)) {
+            setPredicate(word, len);
+        }
+        view_close(&view);
+    }
+    
+    /* 3. The arena no longer moves, so the names can point into it. */
+    int i;
+    for (i = 0; i < num_predicates; i++) {
+        predicates[i].name = symbol_string(&predicate_table, i);
+    }
+    STAT_STOP(PHASE_LOAD);
+}
+
+/*
+ * Open the file at path and call the loader on it. Return false if the
+ * file cannot be opened.
+ */
+bool load_file(const char* path, void (*loader)(FILE*)) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    loader(file);
+    fclose(file);
+    return true;
+}
+
+bool load_constants(const char *path) {
+    return load_file(path, get_constants);
+}
+
+bool load_predicates(const char *path) {
+    return load_file(path, get_predicates);
+}
+
+Formula make_formula() {
+    STAT_START(PHASE_PARSE);
+    tokenizer_open(&input, stdin, EOF);
+    Formula form = parse_input(&input);
+    tokenizer_close(&input);
+    STAT_STOP(PHASE_PARSE);
+    return form;
+}
+
+/*
+ * Parse a formula from a string ended by '\0', as make_formula() does from
+ * standard input.
+ */
+Formula make_formula_from_string(const char *text) {
+    STAT_START(PHASE_PARSE);
+    TOKENIZER in;
+    in.file = NULL;
+    in.delimiter = EOF;
+    in.data = (char*)text;
+    in.size = in.capacity = strlen(text);
+    in.pos = 0;
+    in.mapped = false;
+    in.eof = true;
+    in.pending = false;
+    in.token_len = 0;
+    in.dropped = 0;
+    in.record_start = 0;
+    Formula form = parse_input(&in);
+    STAT_STOP(PHASE_PARSE);
+    return form;
+}
+
+/*
+ * Give back all the memory of the formula: its nodes, words and compiled
+ * code, which all come from the same arena.
+ */
+void formula_free(Formula formula) {
+    if (formula == NULL) {
+        return;
+    }
+    if (formula->mapping != NULL) {
+        munmap(formula->mapping, formula->mapping_size);
+    }
+    ARENA* arena = formula->arena;
+    arena_free(arena);
+    free(arena);
+}
+
+/*
+ * Save a syntactically correct formula to a file, compiled, with its atoms
+ * given by the indexes of their predicate and names. Return false if the
+ * formula is not correct or the file cannot be written.
+ */
+bool save_formula(Formula formula, const char *path) {
+    if (!is_syntactically_correct(formula)) {
+        return false;
+    }
+    PROGRAM* program = compile_formula(formula);
+    
+    /* 1. Number the atoms in order of first occurrence. */
+    assumption ass;
+    ass.num_atoms = 0;
+    ass.atoms = malloc(sizeof(int) * (num_ground_atoms + 1));
+    ass.index = malloc(sizeof(int) * (num_ground_atoms + 1));
+    int i, k;
+    for (i = 0; i < num_ground_atoms; i++) {
+        ass.index[i] = -1;
+    }
+    make_assumptions(program, &ass);
+    
+    FORMULA_FILE header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FORMULA_MAGIC, 4);
+    header.version = FORMULA_VERSION;
+    header.fingerprint = vocabulary_fingerprint();
+    header.num_atoms = ass.num_atoms;
+    header.size = program->size;
+    header.max_depth = program->max_depth;
+    header.num_slots = program->num_slots;
+    int32_t* atoms = malloc(sizeof(int32_t) * 2 * (ass.num_atoms + 1));
+    int32_t* args = malloc(sizeof(int32_t) * (num_atom_args + 1));
+    for (i = 0; i < ass.num_atoms; i++) {
+        ATOM* atom = &ground_atoms[ass.atoms[i]];
+        atoms[2 * i] = atom->predicate;
+        atoms[2 * i + 1] = header.num_args;
+        for (k = 0; k < predicates[atom->predicate].arity; k++) {
+            args[header.num_args++] = atom_args[atom->first_arg + k];
+        }
+    }
+    int32_t* operands = malloc(sizeof(int32_t) * (program->size + 1));
+    for (i = 0; i < program->size; i++) {
+        operands[i] = program->ops[i] == OP_ATOM ? ass.index[program->operands[i]]
+                                                 : program->operands[i];
+    }
+    
+    /* 2. Write it all to a new file that then replaces any file at path,
+     *    which a loaded formula may still have mapped. */
+    char* temp = malloc(strlen(path) + 5);
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+    FILE* file = fopen(temp, "wb");
+    bool written = file != NULL &&
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(atoms, sizeof(int32_t), 2 * ass.num_atoms, file) == 2 * (size_t)ass.num_atoms &&
+        fwrite(args, sizeof(int32_t), header.num_args, file) == header.num_args &&
+        fwrite(operands, sizeof(int32_t), program->size, file) == (size_t)program->size &&
+        fwrite(program->ops, 1, program->size, file) == (size_t)program->size;
+    if (file != NULL && fclose(file) != 0) {
+        written = false;
+    }
+    if (written && rename(temp, path) != 0) {
+        written = false;
+    }
+    if (!written) {
+        remove(temp);
+    }
+    free(temp);
+    free(operands);
+    free(args);
+    free(atoms);
+    free(ass.atoms);
+    free(ass.index);
+    return written;
+}
+
+/*
+ * Load a formula saved by save_formula(). The file is mapped in memory and
+ * its code is run from there: only the operands of OP_ATOM are changed, to
+ * the IDs of the atoms, on private copies of their pages. The formula can
+ * be evaluated and tested for satisfiability, but has no nodes. Return NULL
+ * if the file cannot be read, is not a formula file of this version, or was
+ * made with other names or predicates.
+ */
+Formula load_formula(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FORMULA_FILE)) {
+        data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    size_t file_size = st.st_size;
+    
+    /* 1. Check the header and that the sizes add up to the file's. */
+    FORMULA_FILE* header = data;
+    int32_t* atoms = (int32_t*)(header + 1);
+    int32_t* args = atoms + 2 * (size_t)header->num_atoms;
+    PROGRAM* program = NULL;
+    bool valid = memcmp(header->magic, FORMULA_MAGIC, 4) == 0 &&
+                 header->version == FORMULA_VERSION &&
+                 header->fingerprint == vocabulary_fingerprint() &&
+                 header->size > 0 && header->size < INT32_MAX &&
+                 header->max_depth < INT32_MAX && header->num_slots < INT32_MAX &&
+                 file_size == sizeof(FORMULA_FILE) +
+                              sizeof(int32_t) * (2 * (uint64_t)header->num_atoms +
+                                                 header->num_args + header->size) +
+                              header->size;
+    
+    /* 2. Check the atoms and the code. */
+    int i, k;
+    for (i = 0; valid && i < (int)header->num_atoms; i++) {
+        int predicate = atoms[2 * i];
+        int first = atoms[2 * i + 1];
+        valid = predicate >= 0 && predicate < num_predicates && first >= 0 &&
+                (uint64_t)first + predicates[predicate].arity <= header->num_args;
+        for (k = 0; valid && k < predicates[predicate].arity; k++) {
+            valid = args[first + k] >= 0 && args[first + k] < num_names;
+        }
+    }
+    ARENA* arena = malloc(sizeof(ARENA));
+    arena->blocks = NULL;
+    if (valid) {
+        program = arena_alloc(arena, sizeof(PROGRAM));
+        program->operands = args + header->num_args;
+        program->ops = (uint8_t*)(program->operands + header->size);
+        program->size = header->size;
+        program->max_depth = header->max_depth;
+        program->num_slots = header->num_slots;
+        valid = is_valid_code(program, header->num_atoms);
+    }
+    if (!valid) {
+        arena_free(arena);
+        free(arena);
+        munmap(data, file_size);
+        return NULL;
+    }
+    
+    /* 3. Intern the atoms and give their IDs to the code. */
+    int* ids = malloc(sizeof(int) * (header->num_atoms + 1));
+    for (i = 0; i < (int)header->num_atoms; i++) {
+        ids[i] = intern_atom(atoms[2 * i], &args[atoms[2 * i + 1]]);
+    }
+    for (i = 0; i < program->size; i++) {
+        if (program->ops[i] == OP_ATOM) {
+            program->operands[i] = ids[program->operands[i]];
+        }
+    }
+    free(ids);
+    
+    /* 4. A root with no subformulas, known to be correct, holds the code. */
+    Formula form = arena_alloc(arena, sizeof(formula));
+    memset(form, 0, sizeof(formula));
+    form->arity = -1;
+    form->word = "";
+    form->atom = -1;
+    form->slot = -1;
+    form->checked = true;
+    form->program = program;
+    form->arena = arena;
+    form->mapping = data;
+    form->mapping_size = file_size;
+    return form;
+}
+
+/*
+ * Read the next formula from the file, up to the delimiter or the end of
+ * the file, and store it in formula, or NULL if it is not a formula. Empty
+ * records are skipped. Return false when there is nothing left to read.
+ */
+bool next_formula(FILE *file, int delimiter, Formula* formula) {
+    STAT_START(PHASE_PARSE);
+    if (input.file != file || input.delimiter != delimiter) {
+        tokenizer_open(&input, file, delimiter);
+    }
+    while (true) {
+        next_token(&input);
+        if (input.token_len != 0) {
+            input.pending = true;
+            *formula = parse_input(&input);
+            tokenizer_skip_formula(&input);
+            STAT_STOP(PHASE_PARSE);
+            return true;
         }
-        else {
-            char* atom = formula->word;
-            if (!assumption_exist(atom, ass)) {
-                add_to_assumption(atom, ass);
-            }
+        if (tokenizer_at_end(&input)) {
+            /* The file may be closed, and another opened at the same address. */
+            tokenizer_close(&input);
+            STAT_STOP(PHASE_PARSE);
+            return false;
         }
+        tokenizer_skip_formula(&input);
     }
 }
 
-int get_assumption_index(char* atom, assumption* ass) {
-    int num_atoms = ass->num_atoms;
+void set_witness_to_file(bool to_file) {
+    witness_to_file = to_file;
+}
+
+void print_witness(FILE *file) {
     int i;
-    for (i=0; i<num_atoms; i++) {
-        if (strcmp(atom, ass->atoms[i]) == 0) {
-            return i;
+    for (i = 0; i < num_witness_atoms; i++) {
+        if (i != 0) {
+            fputc(' ', file);
         }
+        print_atom(file, witness_atoms[i]);
     }
-    return -1;
 }
 
-bool is_true_single_atom_assumption(char* atom, assumption* ass) {
-    int i = get_assumption_index(atom, ass);
-    int truth = ass->truth;
+Interpretation make_interpretation(FILE *file) {
+    STAT_START(PHASE_LOAD);
+    Interpretation interp = malloc(sizeof(interpretation));
     
-    if (((1<<i) & (truth)) == 0) {
-        return false;
+    /* 1. Map the file and resolve words to atom IDs. */
+    int  i;
+    int  num_facts = 0;    /* Number of facts read. */
+    int  capacity = 64;
+    int* facts = malloc(sizeof(int) * capacity);
+    FILE_VIEW view;
+    if (view_open(file, &view)) {
+        size_t pos = 0;
+        const char* word;
+        int len;
+        while (next_word(&view, &pos, &word, &len)) {
+            int id = resolve_atom(word, len);
+            if (id != -1) {
+                if (num_facts == capacity) {
+                    capacity *= 2;
+                    facts = realloc(facts, sizeof(int) * capacity);
+                }
+                facts[num_facts++] = id;
+            }
+        }
+        view_close(&view);
     }
-    else {
-        return true;
+    
+    /* 2. Set the bits of the facts. */
+    interp->num_atoms = num_ground_atoms;
+    interp->truth = calloc(sizeof(uint64_t), num_ground_atoms / 64 + 1);
+    for (i = 0; i < num_facts; i++) {
+        interp->truth[facts[i] / 64] |= (uint64_t)1 << (facts[i] % 64);
     }
+    free(facts);
+    STAT_STOP(PHASE_LOAD);
+    
+    return interp;
 }
 
+/*
+ * Check the arity, word and subformulas of a single node.
+ */
+bool is_well_formed_node(Formula formula) {
+    bool connective = strcmp(formula->word, "and") == 0 || strcmp(formula->word, "or") == 0 ||
+                      strcmp(formula->word, "iff") == 0 || strcmp(formula->word, "implies") == 0;
+    bool negation = strcmp(formula->word, "not") == 0;
+    if (formula->arity == 0) {
+        return formula->sub_f1 == NULL && formula->sub_f2 == NULL &&
+               !connective && !negation;
+    }
+    else if (formula->arity == 1) {
+        return negation && formula->sub_f1 != NULL && formula->sub_f2 == NULL;
+    }
+    else if (formula->arity == 2) {
+        return connective && formula->sub_f1 != NULL && formula->sub_f2 != NULL;
+    }
+    return false;
+}
 
-bool is_true_with_assumption(Formula formula, assumption* ass) {
-    if (strcmp(formula->word, "and") == 0) {
-        bool state1 = is_true_with_assumption(formula->sub_f1, ass);
-        bool state2 = is_true_with_assumption(formula->sub_f2, ass);
-        return (state1 && state2);
+/*
+ * Parsing resolves the atoms and checks the nodes, so a parsed formula is
+ * known to be correct or not at once. Only leaves that were not atoms when
+ * they were read, with predicates or names read after them, are resolved
+ * here.
+ */
+bool is_syntactically_correct(Formula formula) {
+    if (formula == NULL) {
+        return false;
     }
-    else if (strcmp(formula->word, "or") == 0) {
-        bool state1 = is_true_with_assumption(formula->sub_f1, ass);
-        bool state2 = is_true_with_assumption(formula->sub_f2, ass);
-        return (state1 || state2);
+    if (formula->checked) {
+        return true;
     }
-    else if (strcmp(formula->word, "iff") == 0) {
-        bool state1 = is_true_with_assumption(formula->sub_f1, ass);
-        bool state2 = is_true_with_assumption(formula->sub_f2, ass);
-        return ((state1 && state2) || (!state1 && !state2));
+    
+    /* Nodes are checked after their subformulas, using a stack in the heap,
+     * and leaves keep the ID of their atom. */
+    int capacity = 64;
+    int top = 0;
+    Formula* stack = malloc(sizeof(Formula) * capacity);
+    bool correct = true;
+    stack[top++] = formula;
+    while (top > 0 && correct) {
+        Formula f = stack[top - 1];
+        if (f->checked) {
+            top--;
+            continue;
+        }
+        if (!is_well_formed_node(f)) {
+            correct = false;
+            break;
+        }
+        if (f->arity == 0) {
+            f->atom = resolve_atom(f->word, strlen(f->word));
+            correct = f->atom != -1;
+            f->checked = correct;
+            top--;
+            continue;
+        }
+        
+        Formula subs[2] = {f->sub_f1, f->sub_f2};
+        bool done = true;
+        int k;
+        for (k = f->arity - 1; k >= 0; k--) {
+            if (!subs[k]->checked) {
+                if (top == capacity) {
+                    capacity *= 2;
+                    stack = realloc(stack, sizeof(Formula) * capacity);
+                }
+                stack[top++] = subs[k];
+                done = false;
+            }
+        }
+        if (done) {
+            f->checked = true;
+            top--;
+        }
     }
-    else if (strcmp(formula->word, "implies") == 0) {
-        bool state1 = is_true_with_assumption(formula->sub_f1, ass);
-        bool state2 = is_true_with_assumption(formula->sub_f2, ass);
-        return !(state1 && !state2);
+    free(stack);
+    return correct;
+}
+
+/*
+ * Return why the last formula parsed is not a formula, and store in offset
+ * the position of the first byte that is wrong, counted from the start of
+ * the formula. Return NULL if it is a formula.
+ */
+const char* get_parse_error(long *offset) {
+    if (parse_error.reason != NULL) {
+        *offset = parse_error.offset;
     }
-    else if (strcmp(formula->word, "not") == 0) {
-        return !is_true_with_assumption(formula->sub_f1, ass);
+    return parse_error.reason;
+}
+
+/*
+ * Make an atom true or false in the interpretation. Return false if the
+ * text is not an atom.
+ */
+bool set_fact(Interpretation interp, const char *atom, bool value) {
+    int id = resolve_atom(atom, strlen(atom));
+    if (id == -1) {
+        return false;
     }
-    else {
-        char* atom = formula->word;
-        return is_true_single_atom_assumption(atom, ass);
+    set_atom(interp, id, value);
+    return true;
+}
+
+void interpretation_free(Interpretation interp) {
+    if (interp == NULL) {
+        return;
     }
+    free(interp->truth);
+    free(interp);
 }
 
-int count_trues(assumption* ass) {
-    int truth = ass->truth;
-    int count = 0;
-    while (truth != 0) {
-        if ((truth & 1) == 1) {
-            count++;
+bool is_true(Formula formula, Interpretation inter) {
+    if (formula->plan == NULL) {
+        PROGRAM* program = compile_formula(formula);
+        STAT_START(PHASE_COMPILE);
+        formula->plan = make_plan(program, formula->arena);
+        STAT_STOP(PHASE_COMPILE);
+    }
+    STAT_START(PHASE_EVAL);
+    bool result = run_plan(formula->plan, inter->truth, inter->num_atoms);
+    STAT_STOP(PHASE_EVAL);
+    return result;
+}
+
+/*
+ * Order the subformulas of each binary node of a formula that has been
+ * evaluated by is_true() so that the one that is cheapest to evaluate,
+ * given how often it settled the node so far, comes first. Results do not
+ * change; only the work to get them does.
+ */
+void reorder_formula(Formula formula) {
+    PLAN* plan = formula->plan;
+    if (plan == NULL) {
+        return;
+    }
+    int i;
+    for (i = 0; i < plan->num_nodes; i++) {
+        if (plan->ops[i] != OP_ATOM && plan->ops[i] != OP_NOT) {
+            plan->first[i] = expected_cost(plan, i, 1) < expected_cost(plan, i, 0);
         }
-        truth = (truth >> 1);
     }
 }
 
-void make_witnesses_satisfiability(Formula formula, assumption* ass) {
-    FILE* file = fopen("witnesses_satisfiability.txt", "w");
-    
-    int num_atoms = ass->num_atoms;
-    int min_trues_count = -1;
-    int min_truth = 0;
+Interpretation load_interpretation(const char *path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+    Interpretation interp = make_interpretation(file);
+    fclose(file);
+    return interp;
+}
+
+/*
+ * Read worlds from the file, one per line, each listing the atoms that are
+ * true in it as true_atoms.txt does.
+ */
+Worlds make_worlds(FILE *file) {
+    STAT_START(PHASE_LOAD);
+    Worlds worlds = malloc(sizeof(struct worlds));
     
-    ass->truth = 0;
-    while ((ass->truth) < (1<<num_atoms)) {
-        if (is_true_with_assumption(formula, ass)) {
-            if (min_trues_count == -1) {
-                min_trues_count = count_trues(ass);
-                min_truth = ass->truth;
-            }
-            else if (count_trues(ass) < min_trues_count){
-                min_trues_count = count_trues(ass);
-                min_truth = ass->truth;
+    /* 1. Map the file and resolve words to atom IDs, with their world. */
+    int  i;
+    int  num_facts = 0;    /* Number of facts read. */
+    int  capacity = 64;
+    int* facts = malloc(sizeof(int) * capacity);
+    int* fact_worlds = malloc(sizeof(int) * capacity);
+    int  num_worlds = 0;
+    FILE_VIEW view;
+    if (view_open(file, &view)) {
+        size_t line = 0;
+        while (line < view.size) {
+            const char* newline = memchr(view.data + line, '\n', view.size - line);
+            size_t end = newline != NULL ? (size_t)(newline - view.data) : view.size;
+            FILE_VIEW line_view = {view.data, end, false, NULL, 0};
+            size_t pos = line;
+            const char* word;
+            int len;
+            while (next_word(&line_view, &pos, &word, &len)) {
+                int id = resolve_atom(word, len);
+                if (id != -1) {
+                    if (num_facts == capacity) {
+                        capacity *= 2;
+                        facts = realloc(facts, sizeof(int) * capacity);
+                        fact_worlds = realloc(fact_worlds, sizeof(int) * capacity);
+                    }
+                    facts[num_facts] = id;
+                    fact_worlds[num_facts++] = num_worlds;
+                }
             }
+            num_worlds++;
+            line = end + 1;
         }
-        (ass->truth)++;
+        view_close(&view);
     }
     
-    int i = 0;
-    while (min_truth != 0) {
-        if ((min_truth & 1) == 1) {
-            fprintf(file, "%s\n", ass->atoms[i]);
-        }
-        min_truth = (min_truth >> 1);
-        i++;
+    /* 2. Set the bits of the facts. */
+    worlds->num_worlds = num_worlds;
+    worlds->num_words = (num_worlds + 63) / 64;
+    worlds->num_atoms = num_ground_atoms;
+    worlds->rows = calloc(sizeof(uint64_t),
+                          (size_t)worlds->num_words * num_ground_atoms + 1);
+    for (i = 0; i < num_facts; i++) {
+        uint64_t* row = worlds->rows + (size_t)facts[i] * worlds->num_words;
+        row[fact_worlds[i] / 64] |= (uint64_t)1 << (fact_worlds[i] % 64);
     }
+    free(fact_worlds);
+    free(facts);
+    STAT_STOP(PHASE_LOAD);
     
-    fclose(file);
+    return worlds;
 }
 
-/* ==================== Functions Implemented =====================*/
+int get_num_worlds(Worlds worlds) {
+    return worlds->num_worlds;
+}
 
-void get_constants(FILE *file) {
-    /* 1. Initialize the 'names' array. */
-    num_names = count_tokens("names.txt");
-    names = calloc(sizeof(char*), num_names);
-    
-    /* 2. Read the file and save the tokens to the names array. */
-    int  i = 0;            /* Current index in the buffer. */
-    int  token_count = 0;  /* Number of tokens read. */ 
-    char c;
-    while ((c = fgetc(file)) != EOF) {
-        if (c == '\r' || c == '\n' || c == '\t' || c == ' ') {
-            if (i != 0) {
-                buff[i] = '\0';
-                i = 0;
-                names[token_count] = calloc(sizeof(char), strlen(buff) + 1);
-                strcpy(names[token_count], buff);
-                token_count++;
-            }
+/*
+ * Return an array telling, for each world, whether the formula is true in
+ * it. The formula is run once per block of up to COLUMN_BLOCK * 64 worlds,
+ * fewer if its stack and kept values would not fit in COLUMN_MEMORY bytes.
+ */
+bool* is_true_in_worlds(Formula formula, Worlds worlds) {
+    PROGRAM* program = compile_formula(formula);
+    STAT_START(PHASE_EVAL);
+    bool* truth = malloc(sizeof(bool) * (worlds->num_worlds + 1));
+    int rows = program->max_depth + program->num_slots;
+    int block = COLUMN_MEMORY / (int)sizeof(uint64_t) / rows;
+    if (block > COLUMN_BLOCK) {
+        block = COLUMN_BLOCK;
+    }
+    if (block < 1) {
+        block = 1;
+    }
+    uint64_t* stack = malloc(sizeof(uint64_t) * block * rows);
+    uint64_t result[COLUMN_BLOCK];
+    int first, w;
+    for (first = 0; first < worlds->num_words; first += block) {
+        int count = worlds->num_words - first;
+        if (count > block) {
+            count = block;
         }
-        else {
-            buff[i++] = c;
+        eval_columns(program, worlds, first, count, stack, result);
+        for (w = 0; w < worlds->num_worlds - first * 64 && w < count * 64; w++) {
+            truth[first * 64 + w] = (result[w / 64] >> (w % 64) & 1) == 1;
         }
     }
+    free(stack);
+    STAT_STOP(PHASE_EVAL);
+    return truth;
 }
 
-void get_predicates(FILE *file) {
-    /* 1. Initialize the 'predicates' array. */
-    num_predicates = count_tokens("predicates.txt");
-    predicates = calloc(sizeof(PREDICATE), num_predicates);
-    
-    /* 2. Read the file and save the tokens to the names array. */
-    int  i = 0;            /* Current index in the buffer. */
-    int  token_count = 0;  /* Number of tokens read. */ 
-    char c;
-    /* Something to be modified here!!!!! */
-    while ((c = fgetc(file)) != EOF) {
-        if (c == '\r' || c == '\n' || c == '\t' || c == ' ') {
-            if (i != 0) {
-                buff[i] = '\0';
-                i = 0;
-                setPredicate(buff, &predicates[token_count]);
-                token_count++;
+/*
+ * Evaluate a formula in an interpretation, keeping the value of each node so
+ * that add_fact() and retract_fact() only evaluate again the nodes above the
+ * atom that changes. Return NULL if the formula is not syntactically correct.
+ */
+Evaluation make_evaluation(Formula formula, Interpretation interp) {
+    /* Formulas loaded from a file only have code. */
+    if (!is_syntactically_correct(formula) || formula->arity < 0) {
+        return NULL;
+    }
+    Evaluation eval = malloc(sizeof(evaluation));
+    int n = formula->id + 1;
+    eval->formula = formula;
+    eval->interp = interp;
+    eval->num_nodes = n;
+    eval->nodes = calloc(sizeof(Formula), n);
+    eval->ops = malloc(sizeof(uint8_t) * n);
+    eval->values = malloc(sizeof(bool) * n);
+    eval->first_parent = calloc(sizeof(int), n + 1);
+    eval->heap = malloc(sizeof(int) * n);
+    eval->heap_size = 0;
+    eval->queued = calloc(sizeof(bool), n);
+    eval->num_atoms = num_ground_atoms;
+    eval->leaves = malloc(sizeof(int) * (num_ground_atoms + 1));
+    int i, k;
+    for (i = 0; i < num_ground_atoms; i++) {
+        eval->leaves[i] = -1;
+    }
+    
+    /* 1. Collect the nodes by id, using the heap as a stack, and count the
+     *    parents of each. */
+    int top = 0;
+    eval->heap[top++] = formula->id;
+    eval->nodes[formula->id] = formula;
+    while (top > 0) {
+        Formula f = eval->nodes[eval->heap[--top]];
+        Formula subs[2] = {f->sub_f1, f->sub_f2};
+        for (k = 0; k < f->arity; k++) {
+            eval->first_parent[subs[k]->id + 1]++;
+            if (eval->nodes[subs[k]->id] == NULL) {
+                eval->nodes[subs[k]->id] = subs[k];
+                eval->heap[top++] = subs[k]->id;
             }
         }
-        else {
-            buff[i++] = c;
+    }
+    
+    /* 2. List the parents of each node. */
+    for (i = 0; i < n; i++) {
+        eval->first_parent[i + 1] += eval->first_parent[i];
+    }
+    eval->parents = malloc(sizeof(int) * (eval->first_parent[n] + 1));
+    int* next = malloc(sizeof(int) * (n + 1));
+    memcpy(next, eval->first_parent, sizeof(int) * n);
+    for (i = 0; i < n; i++) {
+        Formula f = eval->nodes[i];
+        if (f == NULL) {
+            continue;
+        }
+        Formula subs[2] = {f->sub_f1, f->sub_f2};
+        for (k = 0; k < f->arity; k++) {
+            eval->parents[next[subs[k]->id]++] = i;
+        }
+    }
+    free(next);
+    
+    /* 3. Evaluate all nodes, subformulas first. */
+    for (i = 0; i < n; i++) {
+        Formula f = eval->nodes[i];
+        if (f == NULL) {
+            continue;
+        }
+        eval->ops[i] = node_opcode(f);
+        if (f->arity == 0) {
+            eval->leaves[f->atom] = i;
         }
+        eval->values[i] = node_value(eval, i);
     }
+    return eval;
 }
 
-Formula make_formula() {
-    int i = 0;
-    read_user_input();
-    
-    Formula form = recursive_make_formula(&i);
-    
-    /* If there are still extra tokens in the input buffer, return NULL. */
-    nextToken(&i);
-    if (strlen(buff) != 0) {
-        return NULL;
+bool add_fact(Evaluation eval, const char *atom) {
+    return set_evaluation_fact(eval, atom, true);
+}
+
+bool retract_fact(Evaluation eval, const char *atom) {
+    return set_evaluation_fact(eval, atom, false);
+}
+
+bool get_truth_value(Evaluation eval) {
+    return eval->values[eval->formula->id];
+}
+
+void evaluation_free(Evaluation eval) {
+    if (eval == NULL) {
+        return;
+    }
+    free(eval->nodes);
+    free(eval->ops);
+    free(eval->values);
+    free(eval->first_parent);
+    free(eval->parents);
+    free(eval->leaves);
+    free(eval->heap);
+    free(eval->queued);
+    free(eval);
+}
+
+void set_num_threads(int n) {
+    num_threads = n;
+}
+
+/*
+ * Choose how satisfiability is decided: "auto", the default, by trying all
+ * assignments of formulas with few atoms and by the solver otherwise;
+ * "sat", always by the solver; "bdd", by a BDD, with the atoms in a fixed
+ * order; and "bdd-sift", by a BDD whose atoms are reordered by sifting as
+ * it grows. Formulas whose BDD gets too large are left to the default.
+ * Return false for other names.
+ */
+bool set_engine(const char *name) {
+    if (!strcmp(name, "auto") || !strcmp(name, "sat")) {
+        engine = name[0] == 'a' ? ENGINE_AUTO : ENGINE_SAT;
+    }
+    else if (!strcmp(name, "bdd") || !strcmp(name, "bdd-sift")) {
+        engine = ENGINE_BDD;
+        bdd_sifting = name[3] != '\0';
     }
     else {
-        return form;
+        return false;
     }
+    return true;
 }
 
-Interpretation make_interpretation(FILE *file) {
-    Interpretation interp = malloc(sizeof(interpretation));
-    interp->num_atoms = 0;
-    interp->atoms = NULL;
-    
-    /* Read the file and unpack tokens to facts. */
-    int  i = 0;            /* Current index in the buffer. */
-    int  token_count = 0;  /* Number of tokens read. */ 
-    char c;
-    while ((c = fgetc(file)) != EOF) {
-        if (c == '\r' || c == '\n' || c == '\t' || c == ' ') {
-            if (i != 0) {
-                buff[i] = '\0';
-                i = 0;
-                save_atom(buff, interp);
-            }
+/*
+ * Return the number of assignments of the atoms of a syntactically correct
+ * formula that make it true, in decimal, to be freed by the caller. It is
+ * read from the BDD of the formula if that is small enough, and is
+ * otherwise counted exactly on the clauses of the formula, split into
+ * independent components whose counts are cached. The sat engine always
+ * counts on the clauses.
+ */
+char* count_models(Formula formula) {
+    assumption ass;
+    ass.num_atoms = 0;
+    ass.atoms = malloc(sizeof(int) * (num_ground_atoms + 1));
+    ass.index = malloc(sizeof(int) * (num_ground_atoms + 1));
+    int i;
+    for (i = 0; i < num_ground_atoms; i++) {
+        ass.index[i] = -1;
+    }
+    PROGRAM* program = compile_formula(formula);
+    STAT_START(PHASE_SEARCH);
+    make_assumptions(program, &ass);
+    char* digits = NULL;
+    if (engine != ENGINE_SAT) {
+        /* A BDD counts at once whatever its size, so it is tried first,
+         * kept small unless asked for. */
+        int* var_of = malloc(sizeof(int) * (ass.num_atoms + 1));
+        BddManager bdd;
+        int root = build_bdd(program, &ass, var_of,
+                             engine == ENGINE_BDD ? BDD_MAX_NODES : COUNT_BDD_NODES, &bdd);
+        if (root >= 0) {
+            digits = bdd_count(bdd, root);
         }
-        else {
-            buff[i++] = c;
+        bdd_free(bdd);
+        free(var_of);
+    }
+    if (digits == NULL) {
+        /* The variables of the connectives follow from the atoms, so the
+         * models of the clauses are those of the formula. */
+        Counter counter = counter_new();
+        for (i = 0; i < ass.num_atoms; i++) {
+            counter_new_var(counter);
+        }
+        CLAUSES clauses = {NULL, counter, 0};
+        int root = tseitin_encode(program, &ass, &clauses);
+        counter_add_clause(counter, &root, 1);
+        
+        /* The atoms are ordered as for a BDD, which keeps those that occur
+         * together close. */
+        int size = program->size;
+        int* start = malloc(sizeof(int) * (size + 1));
+        bool* joins = malloc(sizeof(bool) * (size + 1));
+        int* ends = malloc(sizeof(int) * (size + 1));
+        int* var_of = malloc(sizeof(int) * (ass.num_atoms + 1));
+        int num_conjuncts = split_conjunction(program, start, joins, ends);
+        order_bdd_vars(program, &ass, start, ends, num_conjuncts, var_of);
+        int* order = malloc(sizeof(int) * (ass.num_atoms + 1));
+        for (i = 0; i < ass.num_atoms; i++) {
+            order[var_of[i]] = i + 1;
         }
+        counter_set_order(counter, order, ass.num_atoms);
+        free(order);
+        free(var_of);
+        free(ends);
+        free(joins);
+        free(start);
+        digits = counter_count(counter);
+        counter_free(counter);
     }
-    
-    return interp;
+    free(ass.atoms);
+    free(ass.index);
+    STAT_STOP(PHASE_SEARCH);
+    return digits;
 }
 
-bool is_syntactically_correct(Formula formula) {
-    /* 1. Check arity */
-    if (formula == NULL) {
-        return false;
-    }
-    else if (formula->arity == 0) {
-        if (formula->sub_f1 != NULL || formula->sub_f2 != NULL) {
-            return false;
+/*
+ * Write the true atoms of a model to the file, on a line, separated by
+ * spaces. Return false once the file cannot be written.
+ */
+bool write_model(const bool* values, void* data) {
+    MODEL_WRITER* writer = data;
+    bool first = true;
+    int i;
+    for (i = 0; i < writer->ass->num_atoms; i++) {
+        if (values[i]) {
+            if (!first) {
+                fputc(' ', writer->file);
+            }
+            print_atom(writer->file, writer->ass->atoms[i]);
+            first = false;
         }
-        if (strcmp(formula->word, "and") == 0 || strcmp(formula->word, "or") == 0 ||
-            strcmp(formula->word, "iff") == 0 || strcmp(formula->word, "implies") == 0) {
-            return false;
+    }
+    fputc('\n', writer->file);
+    return !ferror(writer->file);
+}
+
+/*
+ * Write every assignment of the atoms of a syntactically correct formula
+ * that makes it true to a file, one per line, as its true atoms separated
+ * by spaces; the assignment making all atoms false is an empty line. Each
+ * is written as soon as it is found, and none is kept, so the memory used
+ * does not grow with their number. Return the number written, or -1 if the
+ * file could not be written to.
+ */
+long long write_models(Formula formula, FILE *file) {
+    assumption ass;
+    ass.num_atoms = 0;
+    ass.atoms = malloc(sizeof(int) * (num_ground_atoms + 1));
+    ass.index = malloc(sizeof(int) * (num_ground_atoms + 1));
+    int i;
+    for (i = 0; i < num_ground_atoms; i++) {
+        ass.index[i] = -1;
+    }
+    PROGRAM* program = compile_formula(formula);
+    STAT_START(PHASE_SEARCH);
+    make_assumptions(program, &ass);
+    Counter counter = counter_new();
+    for (i = 0; i < ass.num_atoms; i++) {
+        counter_new_var(counter);
+    }
+    CLAUSES clauses = {NULL, counter, 0};
+    int root = tseitin_encode(program, &ass, &clauses);
+    counter_add_clause(counter, &root, 1);
+    MODEL_WRITER writer;
+    writer.file = file;
+    writer.ass = &ass;
+    long long num_models = counter_enumerate(counter, ass.num_atoms, write_model, &writer);
+    if (ferror(file)) {
+        num_models = -1;
+    }
+    counter_free(counter);
+    free(ass.atoms);
+    free(ass.index);
+    STAT_STOP(PHASE_SEARCH);
+    return num_models;
+}
+
+/*
+ * Return a formula equivalent to a syntactically correct one, in negation
+ * normal form and simplified until nothing changes, and set *value to -1.
+ * If known_true or known_false are given, their true atoms are taken to be
+ * true or false. If the formula turns out to be true or false, return NULL
+ * and set *value to 1 or 0. Formulas loaded from a file cannot be
+ * simplified: NULL is returned and *value set to -1, as for formulas that
+ * are not correct. The formula returned is to be freed by formula_free().
+ */
+Formula simplify_formula(Formula formula, Interpretation known_true,
+                         Interpretation known_false, int *value) {
+    *value = -1;
+    if (!is_syntactically_correct(formula) || formula->arity < 0) {
+        return NULL;
+    }
+    int num_nodes;
+    free(collect_nodes(formula, &num_nodes));
+    Formula current = formula;
+    int pass;
+    for (pass = 0; ; pass++) {
+        ARENA* arena = malloc(sizeof(ARENA));
+        arena->blocks = NULL;
+        Formula next = simplify_pass(current, arena, known_true, known_false);
+        if (current != formula) {
+            formula_free(current);
         }
-        if (strcmp(formula->word, "not") == 0) {
-            return false;
+        if (next == TRUE_NODE || next == FALSE_NODE) {
+            arena_free(arena);
+            free(arena);
+            *value = next == TRUE_NODE;
+            return NULL;
         }
+        next->arena = arena;
+        next->mapping = NULL;
         
-        /* For a single formula, check whether it contains correct components. */
-        return check_single_function(formula->word);
-    }
-    else if (formula->arity == 1) {
-        if (strcmp(formula->word, "and") == 0 || strcmp(formula->word, "or") == 0 ||
-            strcmp(formula->word, "iff") == 0 || strcmp(formula->word, "implies") == 0) {
-            return false;
+        /* The first pass puts the formula in normal form, which can make it
+         * larger; after that, stop once a pass does not make it smaller. */
+        int new_num_nodes;
+        free(collect_nodes(next, &new_num_nodes));
+        if (pass > 0 && new_num_nodes >= num_nodes) {
+            return next;
         }
-        if (strcmp(formula->word, "not") != 0) {
-            return false;
+        num_nodes = new_num_nodes;
+        current = next;
+    }
+}
+
+bool is_satisfiable(Formula formula) {
+    /* 1. Store all atoms that are not listed in the file true_atoms.txt */
+    assumption* ass = malloc(sizeof(assumption));
+    ass->num_atoms = 0;
+    ass->atoms = malloc(sizeof(int) * (num_ground_atoms + 1));
+    ass->index = malloc(sizeof(int) * (num_ground_atoms + 1));
+    int i;
+    for (i = 0; i < num_ground_atoms; i++) {
+        ass->index[i] = -1;
+    }
+    PROGRAM* program = compile_formula(formula);
+    STAT_START(PHASE_SEARCH);
+    make_assumptions(program, ass);
+    
+    /* 2. Simplify the formula, and only keep the atoms that are left, in
+     *    the same order: the others can be false, so the witness is the
+     *    same. The simplified formula is used if it has fewer atoms or is
+     *    no larger. */
+    int value;
+    Formula simple = simplify_formula(formula, NULL, NULL, &value);
+    if (simple != NULL) {
+        PROGRAM* simple_program = compile_formula(simple);
+        bool* kept = calloc(sizeof(bool), num_ground_atoms + 1);
+        int num_kept = 0;
+        for (i = 0; i < simple_program->size; i++) {
+            if (simple_program->ops[i] == OP_ATOM && !kept[simple_program->operands[i]]) {
+                kept[simple_program->operands[i]] = true;
+                num_kept++;
+            }
         }
-        if (formula->sub_f1 == NULL || formula->sub_f2 != NULL) {
-            return false;
+        if (num_kept == ass->num_atoms && simple_program->size > program->size) {
+            memset(kept, true, sizeof(bool) * num_ground_atoms);
         }
         else {
-            return is_syntactically_correct(formula->sub_f1);
+            program = simple_program;
+        }
+        num_kept = 0;
+        for (i = 0; i < ass->num_atoms; i++) {
+            int atom = ass->atoms[i];
+            ass->index[atom] = -1;
+            if (kept[atom]) {
+                ass->index[atom] = num_kept;
+                ass->atoms[num_kept++] = atom;
+            }
         }
+        ass->num_atoms = num_kept;
+        free(kept);
     }
-    else if (formula->arity == 2) {
-        if (strcmp(formula->word, "and") != 0 && strcmp(formula->word, "or") != 0 &&
-            strcmp(formula->word, "iff") != 0 && strcmp(formula->word, "implies") != 0) {
-            return false;
+    
+    /* 3. With the BDD engine, build the BDD of the formula; if it is too
+     *    large, or with the other engines, try all assignments when there
+     *    are few atoms, and otherwise encode the formula into clauses and
+     *    search for a model. */
+    bool satisfiable;
+    int decided = -1;
+    if (value == -1 && engine == ENGINE_BDD) {
+        decided = bdd_search(program, ass);
+    }
+    if (value != -1) {
+        satisfiable = value == 1;
+        if (satisfiable) {
+            ass->num_atoms = 0;
+            write_witnesses(ass, NULL);
         }
-        if (strcmp(formula->word, "not") == 0) {
-            return false;
+    }
+    else if (decided != -1) {
+        satisfiable = decided == 1;
+    }
+    else if (engine != ENGINE_SAT && ass->num_atoms <= TABLE_MAX_ATOMS) {
+        uint64_t witness = 0;
+        satisfiable = table_search(program, ass, &witness);
+        if (satisfiable) {
+            bool in_witness[TABLE_MAX_ATOMS + 1];
+            for (i = 0; i < ass->num_atoms; i++) {
+                in_witness[i] = (witness >> i & 1) == 1;
+            }
+            write_witnesses(ass, in_witness);
         }
-        if (formula->sub_f1 == NULL || formula->sub_f2 == NULL) {
-            return false;
+    }
+    else {
+        Solver solver = sat_new();
+        for (i = 0; i < ass->num_atoms; i++) {
+            sat_new_var(solver);
         }
-        else {
-            bool result1 = is_syntactically_correct(formula->sub_f1);
-            bool result2 = is_syntactically_correct(formula->sub_f2);
-            return (result1 && result2);
+        CLAUSES clauses = {solver, NULL, 0};
+        int root = tseitin_encode(program, ass, &clauses);
+        sat_add_clause(solver, &root, 1);
+        
+        satisfiable = sat_solve(solver, NULL, 0);
+        STAT_ADD(solver_calls, 1);
+        STAT_ADD(witness_candidates, satisfiable);
+        if (satisfiable) {
+            make_witnesses_satisfiability(solver, ass);
         }
+        sat_free(solver);
     }
+    formula_free(simple);
+    free(ass->atoms);
+    free(ass->index);
+    free(ass);
+    STAT_STOP(PHASE_SEARCH);
+    return satisfiable;
 }
 
-bool is_true(Formula formula, Interpretation inter) {
-    if (formula->arity == 0) {
-        char* atom = formula->word;
-        return fact_exist(atom, inter);
+KnowledgeBase make_knowledge_base() {
+    knowledge_base* kb = calloc(1, sizeof(knowledge_base));
+    kb->solver = sat_new();
+    return kb;
+}
+
+/*
+ * Add a syntactically correct formula to the knowledge base, in the group
+ * last pushed if there is one, and for good otherwise.
+ */
+void add_formula(KnowledgeBase kb, Formula formula) {
+    PROGRAM* program = compile_formula(formula);
+    int guard = kb->num_groups > 0 ? -kb->groups[kb->num_groups - 1].guard : 0;
+    int root = encode_in_base(kb, program, guard);
+    CLAUSES clauses = {kb->solver, NULL, guard};
+    add_clause(&clauses, &root, 1);
+}
+
+/*
+ * Open a group of formulas, which the formulas added until it is popped go
+ * to.
+ */
+void push_group(KnowledgeBase kb) {
+    if (kb->num_groups == kb->group_capacity) {
+        kb->group_capacity = kb->group_capacity == 0 ? 16 : 2 * kb->group_capacity;
+        kb->groups = realloc(kb->groups, sizeof(GROUP) * kb->group_capacity);
     }
-    /* NOT */
-    else if (formula->arity == 1) {
-        return !is_true(formula->sub_f1, inter);
+    GROUP* group = &kb->groups[kb->num_groups++];
+    group->guard = sat_new_var(kb->solver);
+    group->first_used = kb->num_used;
+    group->num_live = kb->num_live;
+}
+
+/*
+ * Take back the formulas of the group last pushed, and close it. Return
+ * false if no group is open.
+ */
+bool pop_group(KnowledgeBase kb) {
+    if (kb->num_groups == 0) {
+        return false;
     }
-    else {
-        char* word = formula->word;
-        /* AND */
-        if (strcmp(word, "and") == 0) {
-            bool state1 = is_true(formula->sub_f1, inter);
-            bool state2 = is_true(formula->sub_f2, inter);
-            return (state1 && state2);
-        }
-        /* OR */
-        else if (strcmp(word, "or") == 0) {
-            bool state1 = is_true(formula->sub_f1, inter);
-            bool state2 = is_true(formula->sub_f2, inter);
-            return (state1 || state2);
-        }
-        /* IMPLIES */
-        else if (strcmp(word, "implies") == 0) {
-            bool state1 = is_true(formula->sub_f1, inter);
-            bool state2 = is_true(formula->sub_f2, inter);
-            return !(state1 && !state2);
-        }
-        /* IFF */
-        else {
-            bool state1 = is_true(formula->sub_f1, inter);
-            bool state2 = is_true(formula->sub_f2, inter);
-            return ((state1 && state2) ||
-                   (!state1 && !state2));
+    GROUP* group = &kb->groups[--kb->num_groups];
+    retire(kb, group->guard, group->first_used, group->num_live);
+    return true;
+}
+
+/*
+ * Tell whether the formulas of the knowledge base in force are satisfiable
+ * together with a syntactically correct formula, or alone if the formula
+ * is NULL. If so, the witness is set to the true atoms of a model, among
+ * those of these formulas; unlike that of is_satisfiable(), it does not
+ * have the fewest true atoms. Only the clauses of the formula are added,
+ * for this call only, and what the solver learns is kept for the next.
+ */
+bool is_consistent_with(KnowledgeBase kb, Formula formula) {
+    STAT_START(PHASE_SEARCH);
+    int* lits = malloc(sizeof(int) * (kb->num_groups + 2));
+    int num_lits = 0;
+    int i;
+    for (i = 0; i < kb->num_groups; i++) {
+        lits[num_lits++] = kb->groups[i].guard;
+    }
+    int guard = 0;
+    int first_used = kb->num_used;
+    int num_live = kb->num_live;
+    if (formula != NULL) {
+        PROGRAM* program = compile_formula(formula);
+        guard = sat_new_var(kb->solver);
+        lits[num_lits++] = guard;
+        lits[num_lits++] = encode_in_base(kb, program, -guard);
+    }
+    bool satisfiable = sat_solve(kb->solver, lits, num_lits);
+    STAT_ADD(solver_calls, 1);
+    if (satisfiable) {
+        bool* in_witness = malloc(sizeof(bool) * (kb->ass.num_atoms + 1));
+        for (i = 0; i < kb->ass.num_atoms; i++) {
+            int atom = kb->ass.atoms[i];
+            in_witness[i] = kb->uses[atom] > 0 &&
+                            sat_model_value(kb->solver, kb->ass.index[atom] + 1);
         }
+        write_witnesses(&kb->ass, in_witness);
+        free(in_witness);
     }
-    return false;
+    if (formula != NULL) {
+        retire(kb, guard, first_used, num_live);
+    }
+    free(lits);
+    STAT_STOP(PHASE_SEARCH);
+    return satisfiable;
 }
 
-bool is_satisfiable(Formula formula) {
-    /* 1. Store all atoms that are not listed in the file true_atoms.txt */
-    assumption* ass = malloc(sizeof(assumption));
-    ass->num_atoms = 0;
-    ass->atoms = NULL;
-    ass->truth = 0;
-    make_assumptions(formula, ass);
-    
-    /* 2. Check if the formula is satisfiable */
-    int num_atoms = ass->num_atoms;
-    ass->truth = 0;
-    while ((ass->truth) < (1<<num_atoms)) {
-        if (is_true_with_assumption(formula, ass)) {
-            make_witnesses_satisfiability(formula, ass);
-            return true;
+void knowledge_base_free(KnowledgeBase kb) {
+    sat_free(kb->solver);
+    free(kb->ass.atoms);
+    free(kb->ass.index);
+    free(kb->uses);
+    free(kb->used);
+    free(kb->groups);
+    free(kb);
+}
+
+/*
+ * Write the time spent in each phase and the counters, as a table or as a
+ * JSON object.
+ */
+void print_stats(FILE *file, bool json) {
+#ifdef REASON_STATS
+    const char* counter_names[] = {
+        "tokens", "nodes", "symbol_lookups", "fact_lookups",
+        "assignments", "solver_calls", "witness_candidates"
+    };
+    uint64_t counters[] = {
+        stats.tokens, stats.nodes, stats.symbol_lookups, stats.fact_lookups,
+        stats.assignments, stats.solver_calls, stats.witness_candidates
+    };
+    int num_counters = sizeof(counters) / sizeof(counters[0]);
+    int i;
+    if (json) {
+        fprintf(file, "{\"phases\": {");
+        for (i = 0; i < NUM_PHASES; i++) {
+            fprintf(file, "%s\"%s\": {\"calls\": %llu, \"ns\": %llu}", i == 0 ? "" : ", ",
+                    phase_names[i], (unsigned long long)stats.phase_calls[i],
+                    (unsigned long long)stats.phase_ns[i]);
+        }
+        fprintf(file, "}, \"counters\": {");
+        for (i = 0; i < num_counters; i++) {
+            fprintf(file, "%s\"%s\": %llu", i == 0 ? "" : ", ",
+                    counter_names[i], (unsigned long long)counters[i]);
         }
-        (ass->truth)++;
+        fprintf(file, "}}\n");
+        return;
     }
-    return false;
+    fprintf(file, "%-20s %12s %14s\n", "phase", "calls", "ms");
+    for (i = 0; i < NUM_PHASES; i++) {
+        fprintf(file, "%-20s %12llu %14.3f\n", phase_names[i],
+                (unsigned long long)stats.phase_calls[i], stats.phase_ns[i] / 1e6);
+    }
+    fprintf(file, "%-20s %12s\n", "counter", "count");
+    for (i = 0; i < num_counters; i++) {
+        fprintf(file, "%-20s %12llu\n", counter_names[i], (unsigned long long)counters[i]);
+    }
+#else
+    fprintf(file, json ? "{\"error\": \"statistics are not built in\"}\n"
+                       : "Statistics are not built in; build with -DREASON_STATS.\n");
+#endif
 }
@@ -6,13 +6,50 @@
 
 typedef struct formula *Formula;
 typedef struct interpretation *Interpretation;
+typedef struct worlds *Worlds;
+typedef struct evaluation *Evaluation;
+typedef struct knowledge_base *KnowledgeBase;
 
 void get_constants(FILE *);
 void get_predicates(FILE *);
+bool load_constants(const char *);
+bool load_predicates(const char *);
 Formula make_formula();
+Formula make_formula_from_string(const char *);
+bool next_formula(FILE *, int, Formula *);
+void formula_free(Formula);
+bool save_formula(Formula, const char *);
+Formula load_formula(const char *);
 Interpretation make_interpretation(FILE *);
+Interpretation load_interpretation(const char *);
+bool set_fact(Interpretation, const char *, bool);
+void interpretation_free(Interpretation);
 bool is_syntactically_correct(Formula);
+const char *get_parse_error(long *);
 bool is_true(Formula, Interpretation);
+void reorder_formula(Formula);
+Worlds make_worlds(FILE *);
+int get_num_worlds(Worlds);
+bool *is_true_in_worlds(Formula, Worlds);
+Evaluation make_evaluation(Formula, Interpretation);
+bool add_fact(Evaluation, const char *);
+bool retract_fact(Evaluation, const char *);
+bool get_truth_value(Evaluation);
+void evaluation_free(Evaluation);
+Formula simplify_formula(Formula, Interpretation, Interpretation, int *);
 bool is_satisfiable(Formula);
+char *count_models(Formula);
+long long write_models(Formula, FILE *);
+KnowledgeBase make_knowledge_base();
+void add_formula(KnowledgeBase, Formula);
+void push_group(KnowledgeBase);
+bool pop_group(KnowledgeBase);
+bool is_consistent_with(KnowledgeBase, Formula);
+void knowledge_base_free(KnowledgeBase);
+void set_num_threads(int);
+bool set_engine(const char *);
+void set_witness_to_file(bool);
+void print_witness(FILE *);
+void print_stats(FILE *, bool);
 
 #endif
@@ -0,0 +1,150 @@
+#include "number.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * A number is stored as 32 bit limbs, from the least significant one.
+ */
+typedef struct number {
+    int      size;      /* Limbs in use, 0 for zero, the last one nonzero. */
+    uint32_t limbs[];
+} number;
+
+/* ==================== Helper Functions =====================*/
+
+static Number allocate(int capacity) {
+    Number n = malloc(sizeof(number) + sizeof(uint32_t) * (capacity + 1));
+    n->size = 0;
+    return n;
+}
+
+static void trim(Number n) {
+    while (n->size > 0 && n->limbs[n->size - 1] == 0) {
+        n->size--;
+    }
+}
+
+/* ==================== Functions Implemented =====================*/
+
+Number number_new(unsigned value) {
+    Number n = allocate(1);
+    n->limbs[0] = value;
+    n->size = value != 0;
+    return n;
+}
+
+Number number_copy(Number a) {
+    Number n = allocate(a->size);
+    n->size = a->size;
+    memcpy(n->limbs, a->limbs, sizeof(uint32_t) * a->size);
+    return n;
+}
+
+void number_free(Number n) {
+    free(n);
+}
+
+bool number_is_zero(Number n) {
+    return n->size == 0;
+}
+
+Number number_add(Number a, Number b) {
+    if (a->size < b->size) {
+        Number t = a;
+        a = b;
+        b = t;
+    }
+    Number n = allocate(a->size + 1);
+    uint64_t carry = 0;
+    int i;
+    for (i = 0; i < a->size; i++) {
+        carry += a->limbs[i];
+        if (i < b->size) {
+            carry += b->limbs[i];
+        }
+        n->limbs[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    n->limbs[i] = (uint32_t)carry;
+    n->size = a->size + (carry != 0);
+    return n;
+}
+
+Number number_mul(Number a, Number b) {
+    Number n = allocate(a->size + b->size);
+    if (a->size == 0 || b->size == 0) {
+        return n;
+    }
+    memset(n->limbs, 0, sizeof(uint32_t) * (a->size + b->size));
+    int i, j;
+    for (i = 0; i < a->size; i++) {
+        uint64_t carry = 0;
+        for (j = 0; j < b->size; j++) {
+            carry += (uint64_t)a->limbs[i] * b->limbs[j] + n->limbs[i + j];
+            n->limbs[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        n->limbs[i + b->size] = (uint32_t)carry;
+    }
+    n->size = a->size + b->size;
+    trim(n);
+    return n;
+}
+
+/*
+ * Return a times 2 to the power k.
+ */
+Number number_shift(Number a, int k) {
+    if (a->size == 0) {
+        return allocate(0);
+    }
+    int words = k / 32;
+    int bits = k % 32;
+    Number n = allocate(a->size + words + 1);
+    memset(n->limbs, 0, sizeof(uint32_t) * words);
+    uint32_t carry = 0;
+    int i;
+    for (i = 0; i < a->size; i++) {
+        n->limbs[words + i] = a->limbs[i] << bits | carry;
+        carry = bits == 0 ? 0 : a->limbs[i] >> (32 - bits);
+    }
+    n->limbs[words + a->size] = carry;
+    n->size = words + a->size + 1;
+    trim(n);
+    return n;
+}
+
+/*
+ * Return the number in decimal, to be freed by the caller.
+ */
+char* number_string(Number a) {
+    Number n = number_copy(a);
+    /* Each limb takes at most 10 digits. */
+    char* digits = malloc(10 * (n->size + 1) + 1);
+    int len = 0;
+    int i;
+    do {
+        /* Divide by 10^9, and write the remainder as 9 digits, backwards,
+         * or as few as it takes for the most significant ones. */
+        uint64_t rest = 0;
+        for (i = n->size - 1; i >= 0; i--) {
+            rest = rest << 32 | n->limbs[i];
+            n->limbs[i] = (uint32_t)(rest / 1000000000);
+            rest %= 1000000000;
+        }
+        trim(n);
+        for (i = 0; i < 9 && (n->size > 0 || rest > 0 || len == 0); i++) {
+            digits[len++] = '0' + rest % 10;
+            rest /= 10;
+        }
+    } while (n->size > 0);
+    for (i = 0; i < len / 2; i++) {
+        char t = digits[i];
+        digits[i] = digits[len - 1 - i];
+        digits[len - 1 - i] = t;
+    }
+    digits[len] = '\0';
+    free(n);
+    return digits;
+}
@@ -0,0 +1,22 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stdbool.h>
+
+/*
+ * Natural numbers of any size, for counts of models. Every operation
+ * returns a new number, to be freed by number_free(); its operands are
+ * left alone.
+ */
+typedef struct number *Number;
+
+Number number_new(unsigned);
+Number number_copy(Number);
+void number_free(Number);
+bool number_is_zero(Number);
+Number number_add(Number, Number);
+Number number_mul(Number, Number);
+Number number_shift(Number, int);
+char *number_string(Number);
+
+#endif
@@ -5,41 +5,608 @@
  *                                                                             *
  * Other source files, if any, one per line, starting on the next line:        *
  *        logic.c                                                              *
+ *        sat.c                                                                *
+ *        bdd.c                                                                *
+ *        count.c                                                              *
+ *        number.c                                                             *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+/* For getline(), strdup() and fdopen() under plain C99. */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "logic.h"
 
-int main(void) {
-     FILE *file = fopen("names.txt", "r");
-     if (!file) {
+/* 0 without --stats, 1 for a table, 2 for JSON. */
+int stats_format = 0;
+
+/*
+ * Report the statistics on standard error, so that they do not mix with
+ * the records of a batch, whichever way the program exits.
+ */
+void report_stats(void) {
+     print_stats(stderr, stats_format == 2);
+}
+
+/*
+ * Print why the last formula read is not a formula, if known, with format,
+ * given the offset of the first byte that is wrong and the reason.
+ */
+void print_parse_error(FILE *out, const char *format) {
+     long offset;
+     const char *reason = get_parse_error(&offset);
+     if (reason)
+          fprintf(out, format, offset, reason);
+}
+
+/*
+ * Read the formulas separated by delimiter from the file into a new
+ * knowledge base. Return NULL if the file cannot be opened, or if one of
+ * them is not a formula, setting *bad to its number, from 1.
+ */
+KnowledgeBase load_theory(const char *path, int delimiter, long *bad) {
+     FILE *file = fopen(path, "r");
+     *bad = 0;
+     if (!file)
+          return NULL;
+     KnowledgeBase kb = make_knowledge_base();
+     Formula form;
+     long n = 0;
+     while (!*bad && next_formula(file, delimiter, &form)) {
+          ++n;
+          if (!form || ! is_syntactically_correct(form))
+               *bad = n;
+          else
+               add_formula(kb, form);
+          formula_free(form);
+     }
+     fclose(file);
+     if (*bad) {
+          knowledge_base_free(kb);
+          return NULL;
+     }
+     return kb;
+}
+
+/*
+ * Read formulas separated by delimiter from input until the end, and print
+ * one record per formula: its number, from 1, a tab, then one of
+ * "not a formula" followed by a tab, the offset in the formula of the
+ * first byte that is wrong, a tab and the reason, "true", "not
+ * satisfiable", or "satisfiable" followed by a tab and the atoms of a
+ * witness, separated by spaces. With a knowledge base, formulas are not
+ * evaluated, and are satisfiable if they are together with it.
+ */
+void run_batch(FILE *input, int delimiter, Interpretation interp, KnowledgeBase kb) {
+     Formula form;
+     long n = 0;
+     while (next_formula(input, delimiter, &form)) {
+          printf("%ld\t", ++n);
+          if (!form || ! is_syntactically_correct(form)) {
+               printf("not a formula");
+               print_parse_error(stdout, "\t%ld\t%s");
+               printf("\n");
+          }
+          else if (!kb && is_true(form, interp))
+               printf("true\n");
+          else if (kb ? is_consistent_with(kb, form) : is_satisfiable(form)) {
+               printf("satisfiable\t");
+               print_witness(stdout);
+               printf("\n");
+          }
+          else
+               printf("not satisfiable\n");
+          formula_free(form);
+     }
+}
+
+/*
+ * As run_batch(), but evaluate each formula in every world, printing its
+ * number, a tab, and either "not a formula", with the offset and reason
+ * as for run_batch(), or a 1 or 0 per world.
+ */
+void run_batch_in_worlds(FILE *input, int delimiter, Worlds worlds) {
+     Formula form;
+     long n = 0;
+     int num_worlds = get_num_worlds(worlds);
+     while (next_formula(input, delimiter, &form)) {
+          printf("%ld\t", ++n);
+          if (!form || ! is_syntactically_correct(form)) {
+               printf("not a formula");
+               print_parse_error(stdout, "\t%ld\t%s");
+               printf("\n");
+               formula_free(form);
+               continue;
+          }
+          bool *truth = is_true_in_worlds(form, worlds);
+          for (int i = 0; i < num_worlds; ++i)
+               putchar(truth[i] ? '1' : '0');
+          putchar('\n');
+          free(truth);
+          formula_free(form);
+     }
+}
+
+/* Number of formulas whose evaluation a session keeps. */
+#define EVAL_CACHE_SIZE 64
+
+/*
+ * The formulas a session last evaluated, by their text, with their
+ * evaluations, which add and retract keep up to date: evaluating one of
+ * them again only looks its value up.
+ */
+typedef struct {
+     char *texts[EVAL_CACHE_SIZE];
+     Formula forms[EVAL_CACHE_SIZE];
+     Evaluation evals[EVAL_CACHE_SIZE];
+     int size;
+     int next;          /* The entry to replace when the cache is full. */
+} EVAL_CACHE;
+
+Evaluation find_evaluation(EVAL_CACHE *cache, const char *text) {
+     for (int i = 0; i < cache->size; ++i)
+          if (!strcmp(cache->texts[i], text))
+               return cache->evals[i];
+     return NULL;
+}
+
+/*
+ * Keep the evaluation of the formula in interp, replacing the oldest one
+ * if the cache is full, and return it. The cache now owns the formula.
+ */
+Evaluation cache_evaluation(EVAL_CACHE *cache, const char *text, Formula form,
+                            Interpretation interp) {
+     int i = cache->next;
+     if (cache->size < EVAL_CACHE_SIZE)
+          i = cache->size++;
+     else {
+          free(cache->texts[i]);
+          evaluation_free(cache->evals[i]);
+          formula_free(cache->forms[i]);
+     }
+     cache->next = (i + 1) % EVAL_CACHE_SIZE;
+     cache->texts[i] = strdup(text);
+     cache->forms[i] = form;
+     cache->evals[i] = make_evaluation(form, interp);
+     return cache->evals[i];
+}
+
+void clear_evaluations(EVAL_CACHE *cache) {
+     for (int i = 0; i < cache->size; ++i) {
+          free(cache->texts[i]);
+          evaluation_free(cache->evals[i]);
+          formula_free(cache->forms[i]);
+     }
+     cache->size = 0;
+     cache->next = 0;
+}
+
+/*
+ * Answer requests read from in, one per line, on out, one line each, until
+ * the end of in or "quit". A request is a command and its argument:
+ *
+ *      parse F        "ok" if F can be parsed
+ *      check F        "ok" if F is a formula over the vocabulary
+ *      eval F         "ok true" or "ok false"
+ *      sat F          "ok satisfiable" and the atoms of a witness, or
+ *                     "ok not satisfiable"
+ *      count F        "ok" and the number of assignments of the atoms of F
+ *                     that make it true
+ *      add A          make the atom A true
+ *      retract A      make the atom A false
+ *      reload [file]  read the facts again, from the file if one is given
+ *      assert F       add F to the knowledge base, in the last group pushed
+ *      push           open a group of formulas of the knowledge base
+ *      pop            take back the formulas of the last group pushed
+ *      query [F]      as sat, for F together with the knowledge base, or
+ *                     for the knowledge base alone
+ *      quit
+ *
+ * The last formulas evaluated are kept with their values, which add and
+ * retract update, so evaluating one again costs no more than a lookup.
+ *
+ * Anything that fails is answered by "error" and a reason; for a formula,
+ * the offset of the first byte that is wrong follows.
+ */
+void serve_session(FILE *in, FILE *out, Interpretation *interp, char **facts_file,
+                   KnowledgeBase kb) {
+     EVAL_CACHE cache = {{NULL}, {NULL}, {NULL}, 0, 0};
+     char *line = NULL;
+     size_t capacity = 0;
+     ssize_t len;
+     while ((len = getline(&line, &capacity, in)) != -1) {
+          while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+               line[--len] = '\0';
+          char *arg = strchr(line, ' ');
+          if (arg)
+               *arg++ = '\0';
+          else
+               arg = line + len;
+          if (!strcmp(line, "quit"))
+               break;
+          Evaluation eval = NULL;
+          if (!strcmp(line, "eval") && (eval = find_evaluation(&cache, arg)))
+               fprintf(out, "ok %s\n", get_truth_value(eval) ? "true" : "false");
+          else if (!strcmp(line, "query") && !*arg) {
+               if (is_consistent_with(kb, NULL)) {
+                    fprintf(out, "ok satisfiable ");
+                    print_witness(out);
+                    fprintf(out, "\n");
+               }
+               else
+                    fprintf(out, "ok not satisfiable\n");
+          }
+          else if (!strcmp(line, "parse") || !strcmp(line, "check") ||
+              !strcmp(line, "eval") || !strcmp(line, "sat") ||
+              !strcmp(line, "count") || !strcmp(line, "assert") ||
+              !strcmp(line, "query")) {
+               Formula form = make_formula_from_string(arg);
+               if (!form) {
+                    fprintf(out, "error cannot parse");
+                    print_parse_error(out, " at byte %ld: %s");
+                    fprintf(out, "\n");
+               }
+               else if (!strcmp(line, "parse"))
+                    fprintf(out, "ok\n");
+               else if (! is_syntactically_correct(form)) {
+                    fprintf(out, "error not a formula");
+                    print_parse_error(out, " at byte %ld: %s");
+                    fprintf(out, "\n");
+               }
+               else if (!strcmp(line, "check"))
+                    fprintf(out, "ok\n");
+               else if (!strcmp(line, "eval")) {
+                    eval = cache_evaluation(&cache, arg, form, *interp);
+                    fprintf(out, "ok %s\n", get_truth_value(eval) ? "true" : "false");
+                    form = NULL;
+               }
+               else if (!strcmp(line, "count")) {
+                    char *count = count_models(form);
+                    fprintf(out, "ok %s\n", count);
+                    free(count);
+               }
+               else if (!strcmp(line, "assert")) {
+                    add_formula(kb, form);
+                    fprintf(out, "ok\n");
+               }
+               else if (!strcmp(line, "query") ? is_consistent_with(kb, form)
+                                                : is_satisfiable(form)) {
+                    fprintf(out, "ok satisfiable ");
+                    print_witness(out);
+                    fprintf(out, "\n");
+               }
+               else
+                    fprintf(out, "ok not satisfiable\n");
+               formula_free(form);
+          }
+          else if (!strcmp(line, "add") || !strcmp(line, "retract")) {
+               bool value = !strcmp(line, "add");
+               if (set_fact(*interp, arg, value)) {
+                    for (int i = 0; i < cache.size; ++i)
+                         value ? add_fact(cache.evals[i], arg)
+                               : retract_fact(cache.evals[i], arg);
+                    fprintf(out, "ok\n");
+               }
+               else
+                    fprintf(out, "error not an atom\n");
+          }
+          else if (!strcmp(line, "push")) {
+               push_group(kb);
+               fprintf(out, "ok\n");
+          }
+          else if (!strcmp(line, "pop")) {
+               if (pop_group(kb))
+                    fprintf(out, "ok\n");
+               else
+                    fprintf(out, "error no group to pop\n");
+          }
+          else if (!strcmp(line, "reload")) {
+               Interpretation reloaded = load_interpretation(*arg ? arg : *facts_file);
+               if (!reloaded)
+                    fprintf(out, "error cannot open facts file\n");
+               else {
+                    if (*arg) {
+                         free(*facts_file);
+                         *facts_file = strdup(arg);
+                    }
+                    clear_evaluations(&cache);
+                    interpretation_free(*interp);
+                    *interp = reloaded;
+                    fprintf(out, "ok\n");
+               }
+          }
+          else
+               fprintf(out, "error unknown command\n");
+          fflush(out);
+     }
+     clear_evaluations(&cache);
+     free(line);
+}
+
+/*
+ * Serve the clients of a Unix domain socket bound to path, one after the
+ * other, sharing the vocabulary, the facts and the knowledge base.
+ */
+bool serve_socket(const char *path, Interpretation *interp, char **facts_file,
+                  KnowledgeBase kb) {
+     int server = socket(AF_UNIX, SOCK_STREAM, 0);
+     struct sockaddr_un addr;
+     memset(&addr, 0, sizeof(addr));
+     addr.sun_family = AF_UNIX;
+     if (server == -1 || strlen(path) >= sizeof(addr.sun_path))
+          return false;
+     strcpy(addr.sun_path, path);
+     unlink(path);
+     if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+         listen(server, 16) == -1) {
+          close(server);
+          return false;
+     }
+     int client;
+     while ((client = accept(server, NULL, NULL)) != -1) {
+          FILE *in = fdopen(client, "r");
+          FILE *out = fdopen(dup(client), "w");
+          if (in && out)
+               serve_session(in, out, interp, facts_file, kb);
+          if (in)
+               fclose(in);
+          if (out)
+               fclose(out);
+     }
+     close(server);
+     return true;
+}
+
+/*
+ * Usage: reason [--batch [file]] [--delimiter c] [--worlds file]
+ *               [--names file] [--predicates file] [--facts file]
+ *               [--stats [text|json]] [--serve [socket]]
+ *               [--save file] [--load file] [--engine name]
+ *               [--models file] [--theory file]
+ *
+ * Without options, a single formula is read from standard input. With
+ * --batch, formulas are read from the file, or standard input, one per
+ * line or separated by the given delimiter character, against the
+ * vocabulary and interpretation loaded once.
+ *
+ * With --worlds, formulas are evaluated in each of the worlds listed in the
+ * file, one per line, instead of in true_atoms.txt.
+ *
+ * The vocabulary and interpretation are read from names.txt,
+ * predicates.txt and true_atoms.txt unless other files are given.
+ *
+ * With --save, the formula read is also saved, compiled, to the file; with
+ * --load, the formula is loaded from such a file instead of being read.
+ *
+ * With --serve, the vocabulary and facts are loaded once and requests are
+ * answered, as described for serve_session(), on standard input and
+ * output, or for each client of the Unix domain socket.
+ *
+ * With --models, every assignment of the atoms of the formula read that
+ * makes it true is written to the file as write_models() describes, as
+ * it is found, and their number is printed.
+ *
+ * With --theory, the formulas of the file, separated as for --batch, make
+ * a knowledge base, loaded once. A formula read, or each formula of a
+ * batch, is then not evaluated, but checked for satisfiability together
+ * with it, as is_consistent_with() describes. With --serve, it is the
+ * knowledge base the requests start from, empty otherwise.
+ *
+ * With --engine, satisfiability is decided as set_engine() describes:
+ * auto, sat, bdd or bdd-sift.
+ *
+ * With --stats, the time spent in each phase and the counts of tokens,
+ * nodes, lookups and assignments are written to standard error at the
+ * end, as a table or as JSON. They are only collected when the program is
+ * built with -DREASON_STATS.
+ */
+int main(int argc, char **argv) {
+     bool batch = false;
+     char *batch_file = NULL;
+     int delimiter = '\n';
+     char *worlds_file = NULL;
+     char *names_file = "names.txt";
+     char *predicates_file = "predicates.txt";
+     char *facts_file = "true_atoms.txt";
+     bool serve = false;
+     char *save_file = NULL;
+     char *load_file = NULL;
+     char *socket_path = NULL;
+     char *models_file = NULL;
+     char *theory_file = NULL;
+     for (int i = 1; i < argc; ++i) {
+          if (!strcmp(argv[i], "--batch")) {
+               batch = true;
+               if (i + 1 < argc && strncmp(argv[i + 1], "--", 2))
+                    batch_file = argv[++i];
+          }
+          else if (!strcmp(argv[i], "--delimiter") && i + 1 < argc)
+               delimiter = (unsigned char)argv[++i][0];
+          else if (!strcmp(argv[i], "--worlds") && i + 1 < argc)
+               worlds_file = argv[++i];
+          else if (!strcmp(argv[i], "--names") && i + 1 < argc)
+               names_file = argv[++i];
+          else if (!strcmp(argv[i], "--predicates") && i + 1 < argc)
+               predicates_file = argv[++i];
+          else if (!strcmp(argv[i], "--facts") && i + 1 < argc)
+               facts_file = argv[++i];
+          else if (!strcmp(argv[i], "--serve")) {
+               serve = true;
+               if (i + 1 < argc && strncmp(argv[i + 1], "--", 2))
+                    socket_path = argv[++i];
+          }
+          else if (!strcmp(argv[i], "--save") && i + 1 < argc)
+               save_file = argv[++i];
+          else if (!strcmp(argv[i], "--load") && i + 1 < argc)
+               load_file = argv[++i];
+          else if (!strcmp(argv[i], "--models") && i + 1 < argc)
+               models_file = argv[++i];
+          else if (!strcmp(argv[i], "--theory") && i + 1 < argc)
+               theory_file = argv[++i];
+          else if (!strcmp(argv[i], "--engine") && i + 1 < argc &&
+                   set_engine(argv[i + 1]))
+               ++i;
+          else if (!strcmp(argv[i], "--stats")) {
+               stats_format = 1;
+               if (i + 1 < argc && !strcmp(argv[i + 1], "json")) {
+                    stats_format = 2;
+                    ++i;
+               }
+               else if (i + 1 < argc && !strcmp(argv[i + 1], "text"))
+                    ++i;
+          }
+          else {
+               printf("Usage: %s [--batch [file]] [--delimiter c] [--worlds file]\n"
+                      "       [--names file] [--predicates file] [--facts file]\n"
+                      "       [--stats [text|json]] [--serve [socket]]\n"
+                      "       [--save file] [--load file] [--engine name]\n"
+                      "       [--models file] [--theory file]\n",
+                      argv[0]);
+               return EXIT_FAILURE;
+          }
+     }
+     /* The number of threads of the search can be set in the environment;
+      * by default there is one per core. */
+     if (stats_format)
+          atexit(report_stats);
+     char *threads = getenv("REASON_THREADS");
+     if (threads)
+          set_num_threads(atoi(threads));
+     if (!load_constants(names_file)) {
           printf("Could not open names file. Bye!\n");
           return EXIT_FAILURE;
      }
-     get_constants(file);
-     fclose(file);
-     file = fopen("predicates.txt", "r");
-     if (!file) {
+     if (!load_predicates(predicates_file)) {
           printf("Could not open predicates file. Bye!\n");
           return EXIT_SUCCESS;
      }
-     get_predicates(file);
-     fclose(file);
-     printf("Input possible formula: ");
-     Formula form = make_formula();
+     Worlds worlds = NULL;
+     if (worlds_file) {
+          FILE *file = fopen(worlds_file, "r");
+          if (!file) {
+               printf("Could not open worlds file. Bye!\n");
+               return EXIT_FAILURE;
+          }
+          worlds = make_worlds(file);
+          fclose(file);
+     }
+     KnowledgeBase kb = NULL;
+     if (theory_file) {
+          long bad;
+          kb = load_theory(theory_file, delimiter, &bad);
+          if (!kb && bad) {
+               printf("Formula %ld of theory file is not a formula", bad);
+               print_parse_error(stdout, " at byte %ld: %s");
+               printf(". Bye!\n");
+               return EXIT_FAILURE;
+          }
+          if (!kb) {
+               printf("Could not open theory file. Bye!\n");
+               return EXIT_FAILURE;
+          }
+     }
+     if (serve) {
+          Interpretation interp = load_interpretation(facts_file);
+          if (!interp) {
+               printf("Could not open interpretation file. Bye!\n");
+               return EXIT_FAILURE;
+          }
+          facts_file = strdup(facts_file);
+          set_witness_to_file(false);
+          if (!kb)
+               kb = make_knowledge_base();
+          if (!socket_path)
+               serve_session(stdin, stdout, &interp, &facts_file, kb);
+          else if (!serve_socket(socket_path, &interp, &facts_file, kb)) {
+               printf("Could not listen on socket. Bye!\n");
+               return EXIT_FAILURE;
+          }
+          return EXIT_SUCCESS;
+     }
+     if (batch) {
+          Interpretation interp = NULL;
+          if (!worlds) {
+               interp = load_interpretation(facts_file);
+               if (!interp) {
+                    printf("Could not open interpretation file. Bye!\n");
+                    return EXIT_FAILURE;
+               }
+          }
+          FILE *input = stdin;
+          if (batch_file) {
+               input = fopen(batch_file, "r");
+               if (!input) {
+                    printf("Could not open formulas file. Bye!\n");
+                    return EXIT_FAILURE;
+               }
+          }
+          set_witness_to_file(false);
+          if (worlds)
+               run_batch_in_worlds(input, delimiter, worlds);
+          else
+               run_batch(input, delimiter, interp, kb);
+          if (input != stdin)
+               fclose(input);
+          return EXIT_SUCCESS;
+     }
+     Formula form;
+     if (load_file) {
+          form = load_formula(load_file);
+          if (!form) {
+               printf("Could not load formula file. Bye!\n");
+               return EXIT_FAILURE;
+          }
+     }
+     else {
+          printf("Input possible formula: ");
+          form = make_formula();
+     }
      if (!form || ! is_syntactically_correct(form)) {
           printf("Possible formula is not a formula.\n");
+          print_parse_error(stdout, "Error at byte %ld: %s.\n");
           return EXIT_SUCCESS;
      }
      printf("Possible formula is indeed a formula.\n");
-     file = fopen("true_atoms.txt", "r");
-     if (!file) {
+     if (save_file && !save_formula(form, save_file)) {
+          printf("Could not save formula file. Bye!\n");
+          return EXIT_FAILURE;
+     }
+     if (models_file) {
+          FILE *file = fopen(models_file, "w");
+          long long num_models = file ? write_models(form, file) : -1;
+          if (file && fclose(file) != 0)
+               num_models = -1;
+          if (num_models < 0) {
+               printf("Could not write models file. Bye!\n");
+               return EXIT_FAILURE;
+          }
+          printf("Formula has %lld models.\n", num_models);
+     }
+     if (worlds) {
+          bool *truth = is_true_in_worlds(form, worlds);
+          for (int i = 0; i < get_num_worlds(worlds); ++i)
+               printf("Formula is %s in world %d.\n",
+                      truth[i] ? "true" : "false", i + 1);
+          free(truth);
+          return EXIT_SUCCESS;
+     }
+     if (kb) {
+          if (is_consistent_with(kb, form))
+               printf("Formula is satisfiable together with the theory.\n");
+          else
+               printf("Formula is not satisfiable together with the theory.\n");
+          return EXIT_SUCCESS;
+     }
+     Interpretation interp = load_interpretation(facts_file);
+     if (!interp) {
           printf("Could not open interpretation file. Bye!\n");
           return EXIT_FAILURE;
      }
-     Interpretation interp = make_interpretation(file);
-     fclose(file);
      if (is_true(form, interp)) {
           printf("Formula is true in given interpretation.\n");
           return EXIT_SUCCESS;
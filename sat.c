@@ -0,0 +1,900 @@
+#include "sat.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Literals are stored internally as 2 * var + sign, with variables
+ * numbered from 0, so that a literal and its negation differ in the
+ * lowest bit only.
+ */
+#define LIT_UNDEF     -1
+#define CLAUSE_NONE   -1
+
+#define VAR_DECAY     0.95
+#define CLAUSE_DECAY  0.999
+#define RESTART_FIRST 100
+
+/* The learnt clause limit grows by LEARNTS_GROWTH every time a growing
+ * number of conflicts has been seen, starting with LEARNTS_ADJUST_FIRST. */
+#define LEARNTS_ADJUST_FIRST 100
+#define LEARNTS_ADJUST_INC   1.5
+#define LEARNTS_GROWTH       1.1
+
+typedef struct clause {
+    int     size;
+    bool    learnt;
+    double  activity;
+    int     lits[];
+} clause;
+
+typedef struct watcher {
+    int clause;   /* Index of the watching clause. */
+    int blocker;  /* A literal of the clause; if true, the clause is skipped. */
+} watcher;
+
+typedef struct watch_list {
+    watcher* data;
+    int      size;
+    int      capacity;
+} watch_list;
+
+typedef struct solver {
+    bool    ok;            /* False once the clause set is known unsatisfiable. */
+    int     num_vars;
+    int     var_capacity;
+
+    /* Per variable data. */
+    signed char* assigns;  /* 1 for true, -1 for false, 0 if unassigned. */
+    int*    level;
+    int*    reason;
+    double* activity;
+    bool*   polarity;      /* Saved phase: true means the negative literal. */
+    bool*   seen;
+    bool*   model;
+    bool*   failed;        /* Per literal: an assumption of the final conflict. */
+    int*    heap;          /* Max-heap of variables ordered by activity. */
+    int*    heap_index;    /* Position in the heap, or -1. */
+    int     heap_size;
+
+    /* Per literal data. */
+    watch_list* watches;
+
+    /* Assignment trail. */
+    int*    trail;
+    int     trail_size;
+    int*    trail_lim;
+    int     num_levels;
+    int     qhead;
+
+    /* Clause database. */
+    clause** clauses;
+    int     num_clauses;
+    int     clause_capacity;
+    int*    free_clauses;  /* Indices of deleted clauses for reuse. */
+    int     num_free_clauses;
+    int     free_capacity;
+    int     num_learnts;
+    double  max_learnts;
+    double  learnts_adjust_confl;
+    int     learnts_adjust_count;
+
+    double  var_inc;
+    double  clause_inc;
+
+    /* Scratch space for conflict analysis. */
+    int*    learnt;
+    int     learnt_size;
+    int*    to_clear;
+    int     to_clear_size;
+} solver;
+
+/* ==================== Helper Functions =====================*/
+
+static int lit_var(int lit) {
+    return lit >> 1;
+}
+
+static bool lit_sign(int lit) {
+    return (lit & 1) == 1;
+}
+
+static int make_lit(int var, bool negative) {
+    return var + var + (negative ? 1 : 0);
+}
+
+/*
+ * Convert a DIMACS style literal to the internal representation.
+ */
+static int from_dimacs(int lit) {
+    return lit > 0 ? make_lit(lit - 1, false) : make_lit(-lit - 1, true);
+}
+
+/*
+ * Return 1 if the literal is true, -1 if it is false, 0 if unassigned.
+ */
+static int lit_value(Solver s, int lit) {
+    int value = s->assigns[lit_var(lit)];
+    return lit_sign(lit) ? -value : value;
+}
+
+static void* grow_array(void* array, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) {
+        return array;
+    }
+    int new_capacity = *capacity == 0 ? 16 : *capacity;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    *capacity = new_capacity;
+    return realloc(array, elem_size * new_capacity);
+}
+
+static void watch_push(watch_list* list, int clause_index, int blocker) {
+    list->data = grow_array(list->data, &list->capacity, list->size + 1,
+                            sizeof(watcher));
+    list->data[list->size].clause = clause_index;
+    list->data[list->size].blocker = blocker;
+    list->size++;
+}
+
+/* ==================== Variable Order Heap =====================*/
+
+static bool heap_less(Solver s, int v1, int v2) {
+    return s->activity[v1] > s->activity[v2];
+}
+
+static void heap_up(Solver s, int i) {
+    int v = s->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (!heap_less(s, v, s->heap[parent])) {
+            break;
+        }
+        s->heap[i] = s->heap[parent];
+        s->heap_index[s->heap[i]] = i;
+        i = parent;
+    }
+    s->heap[i] = v;
+    s->heap_index[v] = i;
+}
+
+static void heap_down(Solver s, int i) {
+    int v = s->heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_size) {
+            break;
+        }
+        if (child + 1 < s->heap_size && heap_less(s, s->heap[child + 1], s->heap[child])) {
+            child++;
+        }
+        if (!heap_less(s, s->heap[child], v)) {
+            break;
+        }
+        s->heap[i] = s->heap[child];
+        s->heap_index[s->heap[i]] = i;
+        i = child;
+    }
+    s->heap[i] = v;
+    s->heap_index[v] = i;
+}
+
+static void heap_insert(Solver s, int v) {
+    if (s->heap_index[v] >= 0) {
+        return;
+    }
+    s->heap[s->heap_size] = v;
+    s->heap_index[v] = s->heap_size;
+    s->heap_size++;
+    heap_up(s, s->heap_size - 1);
+}
+
+static int heap_pop(Solver s) {
+    int v = s->heap[0];
+    s->heap_size--;
+    s->heap_index[v] = -1;
+    if (s->heap_size > 0) {
+        s->heap[0] = s->heap[s->heap_size];
+        heap_down(s, 0);
+    }
+    return v;
+}
+
+/*
+ * Bump the activity of a variable (VSIDS). Activities are rescaled when
+ * they become too large, which keeps their relative order.
+ */
+static void bump_var(Solver s, int v) {
+    s->activity[v] += s->var_inc;
+    if (s->activity[v] > 1e100) {
+        int i;
+        for (i = 0; i < s->num_vars; i++) {
+            s->activity[i] *= 1e-100;
+        }
+        s->var_inc *= 1e-100;
+    }
+    if (s->heap_index[v] >= 0) {
+        heap_up(s, s->heap_index[v]);
+    }
+}
+
+static void bump_clause(Solver s, clause* c) {
+    c->activity += s->clause_inc;
+    if (c->activity > 1e20) {
+        int i;
+        for (i = 0; i < s->num_clauses; i++) {
+            if (s->clauses[i] != NULL && s->clauses[i]->learnt) {
+                s->clauses[i]->activity *= 1e-20;
+            }
+        }
+        s->clause_inc *= 1e-20;
+    }
+}
+
+/* ==================== Assignment Trail =====================*/
+
+static void enqueue(Solver s, int lit, int reason) {
+    int v = lit_var(lit);
+    s->assigns[v] = lit_sign(lit) ? -1 : 1;
+    s->level[v] = s->num_levels;
+    s->reason[v] = reason;
+    s->trail[s->trail_size++] = lit;
+}
+
+static void new_decision_level(Solver s) {
+    s->trail_lim[s->num_levels++] = s->trail_size;
+}
+
+/*
+ * Undo all assignments above the given decision level.
+ */
+static void cancel_until(Solver s, int level) {
+    if (s->num_levels <= level) {
+        return;
+    }
+    int i;
+    for (i = s->trail_size - 1; i >= s->trail_lim[level]; i--) {
+        int v = lit_var(s->trail[i]);
+        s->assigns[v] = 0;
+        s->reason[v] = CLAUSE_NONE;
+        s->polarity[v] = lit_sign(s->trail[i]);
+        heap_insert(s, v);
+    }
+    s->trail_size = s->trail_lim[level];
+    s->qhead = s->trail_size;
+    s->num_levels = level;
+}
+
+/* ==================== Clause Database =====================*/
+
+static int attach_clause(Solver s, const int* lits, int size, bool learnt) {
+    int index;
+    if (s->num_free_clauses > 0) {
+        index = s->free_clauses[--(s->num_free_clauses)];
+    }
+    else {
+        s->clauses = grow_array(s->clauses, &s->clause_capacity,
+                                s->num_clauses + 1, sizeof(clause*));
+        index = s->num_clauses++;
+    }
+    clause* c = malloc(sizeof(clause) + sizeof(int) * size);
+    c->size = size;
+    c->learnt = learnt;
+    c->activity = 0;
+    memcpy(c->lits, lits, sizeof(int) * size);
+    s->clauses[index] = c;
+
+    watch_push(&s->watches[c->lits[0]], index, c->lits[1]);
+    watch_push(&s->watches[c->lits[1]], index, c->lits[0]);
+    if (learnt) {
+        s->num_learnts++;
+    }
+    return index;
+}
+
+static bool is_locked(Solver s, int index) {
+    clause* c = s->clauses[index];
+    int v = lit_var(c->lits[0]);
+    return s->reason[v] == index && lit_value(s, c->lits[0]) == 1;
+}
+
+static int compare_activity(const void* a, const void* b) {
+    double x = (*(clause* const*)a)->activity;
+    double y = (*(clause* const*)b)->activity;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Drop the watchers of deleted clauses, then recycle their indices.
+ */
+static void purge_deleted(Solver s) {
+    int i, j;
+    for (i = 0; i < 2 * s->num_vars; i++) {
+        watch_list* list = &s->watches[i];
+        int k = 0;
+        for (j = 0; j < list->size; j++) {
+            if (s->clauses[list->data[j].clause] != NULL) {
+                list->data[k++] = list->data[j];
+            }
+        }
+        list->size = k;
+    }
+    s->num_free_clauses = 0;
+    for (i = 0; i < s->num_clauses; i++) {
+        if (s->clauses[i] == NULL) {
+            s->free_clauses = grow_array(s->free_clauses, &s->free_capacity,
+                                         s->num_free_clauses + 1, sizeof(int));
+            s->free_clauses[s->num_free_clauses++] = i;
+        }
+    }
+}
+
+/*
+ * Remove about half of the learnt clauses, keeping the most active ones,
+ * binary clauses and those that are the reason for a current assignment.
+ */
+static void reduce_db(Solver s) {
+    clause** learnts = malloc(sizeof(clause*) * s->num_learnts);
+    int num = 0;
+    int i;
+    for (i = 0; i < s->num_clauses; i++) {
+        if (s->clauses[i] != NULL && s->clauses[i]->learnt) {
+            learnts[num++] = s->clauses[i];
+        }
+    }
+    qsort(learnts, num, sizeof(clause*), compare_activity);
+    double threshold = num > 0 ? learnts[num / 2]->activity : 0;
+    free(learnts);
+
+    bool removed = false;
+    for (i = 0; i < s->num_clauses; i++) {
+        clause* c = s->clauses[i];
+        if (c == NULL || !c->learnt || c->size <= 2 || is_locked(s, i) ||
+            c->activity >= threshold) {
+            continue;
+        }
+        free(c);
+        s->clauses[i] = NULL;
+        s->num_learnts--;
+        removed = true;
+    }
+    if (removed) {
+        purge_deleted(s);
+    }
+}
+
+/* ==================== Search =====================*/
+
+/*
+ * Unit propagation over the two watched literals of each clause.
+ * Return the index of a conflicting clause, or CLAUSE_NONE.
+ */
+static int propagate(Solver s) {
+    int conflict = CLAUSE_NONE;
+    while (s->qhead < s->trail_size) {
+        int p = s->trail[s->qhead++];
+        int false_lit = p ^ 1;
+        watch_list* list = &s->watches[false_lit];
+        int i = 0;
+        int j = 0;
+        while (i < list->size) {
+            watcher w = list->data[i++];
+            if (lit_value(s, w.blocker) == 1) {
+                list->data[j++] = w;
+                continue;
+            }
+            clause* c = s->clauses[w.clause];
+            if (c->lits[0] == false_lit) {
+                c->lits[0] = c->lits[1];
+                c->lits[1] = false_lit;
+            }
+            int first = c->lits[0];
+            if (first != w.blocker && lit_value(s, first) == 1) {
+                list->data[j].clause = w.clause;
+                list->data[j].blocker = first;
+                j++;
+                continue;
+            }
+
+            /* Look for a new literal to watch. */
+            bool found = false;
+            int k;
+            for (k = 2; k < c->size; k++) {
+                if (lit_value(s, c->lits[k]) != -1) {
+                    c->lits[1] = c->lits[k];
+                    c->lits[k] = false_lit;
+                    watch_push(&s->watches[c->lits[1]], w.clause, first);
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                continue;
+            }
+
+            /* The clause is unit or conflicting. */
+            list->data[j].clause = w.clause;
+            list->data[j].blocker = first;
+            j++;
+            if (lit_value(s, first) == -1) {
+                conflict = w.clause;
+                s->qhead = s->trail_size;
+                while (i < list->size) {
+                    list->data[j++] = list->data[i++];
+                }
+            }
+            else {
+                enqueue(s, first, w.clause);
+            }
+        }
+        list->size = j;
+        if (conflict != CLAUSE_NONE) {
+            break;
+        }
+    }
+    return conflict;
+}
+
+/*
+ * A literal of a learnt clause is redundant if it is implied by other
+ * literals of the clause, i.e. all the literals of its reason are either
+ * in the clause already or assigned at level 0.
+ */
+static bool lit_redundant(Solver s, int lit) {
+    int reason = s->reason[lit_var(lit)];
+    if (reason == CLAUSE_NONE) {
+        return false;
+    }
+    clause* c = s->clauses[reason];
+    int k;
+    for (k = 1; k < c->size; k++) {
+        int v = lit_var(c->lits[k]);
+        if (!s->seen[v] && s->level[v] > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * First UIP conflict analysis. The learnt clause is left in s->learnt,
+ * with the asserting literal first and a literal of the backtrack level
+ * second. Return the backtrack level.
+ */
+static int analyze(Solver s, int conflict) {
+    int path_count = 0;
+    int p = LIT_UNDEF;
+    int index = s->trail_size - 1;
+    int i;
+
+    s->learnt_size = 1;
+    s->to_clear_size = 0;
+    do {
+        clause* c = s->clauses[conflict];
+        if (c->learnt) {
+            bump_clause(s, c);
+        }
+        for (i = (p == LIT_UNDEF) ? 0 : 1; i < c->size; i++) {
+            int q = c->lits[i];
+            int v = lit_var(q);
+            if (!s->seen[v] && s->level[v] > 0) {
+                bump_var(s, v);
+                s->seen[v] = true;
+                s->to_clear[s->to_clear_size++] = v;
+                if (s->level[v] >= s->num_levels) {
+                    path_count++;
+                }
+                else {
+                    s->learnt[s->learnt_size++] = q;
+                }
+            }
+        }
+        while (!s->seen[lit_var(s->trail[index])]) {
+            index--;
+        }
+        p = s->trail[index--];
+        conflict = s->reason[lit_var(p)];
+        s->seen[lit_var(p)] = false;
+        path_count--;
+    } while (path_count > 0);
+    s->learnt[0] = p ^ 1;
+
+    /* Remove redundant literals. */
+    int j = 1;
+    for (i = 1; i < s->learnt_size; i++) {
+        if (!lit_redundant(s, s->learnt[i])) {
+            s->learnt[j++] = s->learnt[i];
+        }
+    }
+    s->learnt_size = j;
+    for (i = 0; i < s->to_clear_size; i++) {
+        s->seen[s->to_clear[i]] = false;
+    }
+
+    /* Find the backtrack level and put one of its literals second. */
+    if (s->learnt_size == 1) {
+        return 0;
+    }
+    int max_i = 1;
+    for (i = 2; i < s->learnt_size; i++) {
+        if (s->level[lit_var(s->learnt[i])] > s->level[lit_var(s->learnt[max_i])]) {
+            max_i = i;
+        }
+    }
+    int tmp = s->learnt[1];
+    s->learnt[1] = s->learnt[max_i];
+    s->learnt[max_i] = tmp;
+    return s->level[lit_var(s->learnt[1])];
+}
+
+/*
+ * The assumption p is false: mark as failed the assumptions it follows
+ * from, by going back through the reasons of the trail.
+ */
+static void analyze_final(Solver s, int p) {
+    s->failed[p] = true;
+    if (s->num_levels == 0) {
+        return;
+    }
+    s->seen[lit_var(p)] = true;
+    int i, k;
+    for (i = s->trail_size - 1; i >= s->trail_lim[0]; i--) {
+        int v = lit_var(s->trail[i]);
+        if (!s->seen[v]) {
+            continue;
+        }
+        if (s->reason[v] == CLAUSE_NONE) {
+            s->failed[s->trail[i]] = true;
+        }
+        else {
+            clause* c = s->clauses[s->reason[v]];
+            for (k = 1; k < c->size; k++) {
+                if (s->level[lit_var(c->lits[k])] > 0) {
+                    s->seen[lit_var(c->lits[k])] = true;
+                }
+            }
+        }
+        s->seen[v] = false;
+    }
+    s->seen[lit_var(p)] = false;
+}
+
+static int pick_branch_lit(Solver s) {
+    while (s->heap_size > 0) {
+        int v = heap_pop(s);
+        if (s->assigns[v] == 0) {
+            return make_lit(v, s->polarity[v]);
+        }
+    }
+    return LIT_UNDEF;
+}
+
+/*
+ * The Luby restart sequence 1, 1, 2, 1, 1, 2, 4, 1, ...
+ */
+static long luby(int x) {
+    int size = 1;
+    int seq = 0;
+    while (size < x + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != x) {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+    return 1L << seq;
+}
+
+/*
+ * Search until a model is found (return 1), the formula is shown
+ * unsatisfiable under the assumptions (return 0), or the conflict budget
+ * is exhausted (return -1).
+ */
+static int search(Solver s, const int* assumptions, int num_assumptions,
+                  long max_conflicts) {
+    long conflicts = 0;
+    for (;;) {
+        int conflict = propagate(s);
+        if (conflict != CLAUSE_NONE) {
+            conflicts++;
+            if (s->num_levels == 0) {
+                s->ok = false;
+                return 0;
+            }
+            int back_level = analyze(s, conflict);
+            cancel_until(s, back_level);
+            if (s->learnt_size == 1) {
+                enqueue(s, s->learnt[0], CLAUSE_NONE);
+            }
+            else {
+                int index = attach_clause(s, s->learnt, s->learnt_size, true);
+                bump_clause(s, s->clauses[index]);
+                enqueue(s, s->learnt[0], index);
+            }
+            s->var_inc /= VAR_DECAY;
+            s->clause_inc /= CLAUSE_DECAY;
+            if (--(s->learnts_adjust_count) == 0) {
+                s->learnts_adjust_confl *= LEARNTS_ADJUST_INC;
+                s->learnts_adjust_count = (int)s->learnts_adjust_confl;
+                s->max_learnts *= LEARNTS_GROWTH;
+            }
+            continue;
+        }
+
+        if (conflicts >= max_conflicts) {
+            cancel_until(s, 0);
+            return -1;
+        }
+        if (s->num_learnts - s->trail_size >= s->max_learnts) {
+            reduce_db(s);
+        }
+
+        /* Assumptions are decided first, one per decision level. */
+        int next = LIT_UNDEF;
+        while (s->num_levels < num_assumptions) {
+            int p = assumptions[s->num_levels];
+            if (lit_value(s, p) == 1) {
+                new_decision_level(s);
+            }
+            else if (lit_value(s, p) == -1) {
+                analyze_final(s, p);
+                return 0;
+            }
+            else {
+                next = p;
+                break;
+            }
+        }
+        if (next == LIT_UNDEF) {
+            next = pick_branch_lit(s);
+            if (next == LIT_UNDEF) {
+                return 1;
+            }
+        }
+        new_decision_level(s);
+        enqueue(s, next, CLAUSE_NONE);
+    }
+}
+
+/* ==================== Functions Implemented =====================*/
+
+Solver sat_new(void) {
+    Solver s = calloc(1, sizeof(solver));
+    s->ok = true;
+    s->var_inc = 1;
+    s->clause_inc = 1;
+    return s;
+}
+
+void sat_free(Solver s) {
+    int i;
+    for (i = 0; i < s->num_clauses; i++) {
+        if (s->clauses[i] != NULL) {
+            free(s->clauses[i]);
+        }
+    }
+    for (i = 0; i < 2 * s->num_vars; i++) {
+        free(s->watches[i].data);
+    }
+    free(s->clauses);
+    free(s->free_clauses);
+    free(s->watches);
+    free(s->assigns);
+    free(s->level);
+    free(s->reason);
+    free(s->activity);
+    free(s->polarity);
+    free(s->seen);
+    free(s->model);
+    free(s->failed);
+    free(s->heap);
+    free(s->heap_index);
+    free(s->trail);
+    free(s->trail_lim);
+    free(s->learnt);
+    free(s->to_clear);
+    free(s);
+}
+
+int sat_new_var(Solver s) {
+    int v = s->num_vars;
+    if (v == s->var_capacity) {
+        int capacity = s->var_capacity == 0 ? 64 : 2 * s->var_capacity;
+        s->assigns    = realloc(s->assigns, sizeof(signed char) * capacity);
+        s->level      = realloc(s->level, sizeof(int) * capacity);
+        s->reason     = realloc(s->reason, sizeof(int) * capacity);
+        s->activity   = realloc(s->activity, sizeof(double) * capacity);
+        s->polarity   = realloc(s->polarity, sizeof(bool) * capacity);
+        s->seen       = realloc(s->seen, sizeof(bool) * capacity);
+        s->model      = realloc(s->model, sizeof(bool) * capacity);
+        s->failed     = realloc(s->failed, sizeof(bool) * 2 * capacity);
+        s->heap       = realloc(s->heap, sizeof(int) * capacity);
+        s->heap_index = realloc(s->heap_index, sizeof(int) * capacity);
+        s->trail      = realloc(s->trail, sizeof(int) * capacity);
+        s->trail_lim  = realloc(s->trail_lim, sizeof(int) * capacity);
+        s->learnt     = realloc(s->learnt, sizeof(int) * capacity);
+        s->to_clear   = realloc(s->to_clear, sizeof(int) * capacity);
+        s->watches    = realloc(s->watches, sizeof(watch_list) * 2 * capacity);
+        memset(s->watches + 2 * s->var_capacity, 0,
+               sizeof(watch_list) * 2 * (capacity - s->var_capacity));
+        s->var_capacity = capacity;
+    }
+    s->num_vars++;
+    s->assigns[v] = 0;
+    s->level[v] = 0;
+    s->reason[v] = CLAUSE_NONE;
+    s->activity[v] = 0;
+    s->polarity[v] = true;
+    s->seen[v] = false;
+    s->model[v] = false;
+    s->failed[2 * v] = false;
+    s->failed[2 * v + 1] = false;
+    s->heap_index[v] = -1;
+    heap_insert(s, v);
+    return v + 1;
+}
+
+int sat_num_vars(Solver s) {
+    return s->num_vars;
+}
+
+/*
+ * Add a clause, given as DIMACS literals. Variables that do not exist yet
+ * are created. Return false if the clause set became unsatisfiable.
+ */
+bool sat_add_clause(Solver s, const int* lits, int num_lits) {
+    if (!s->ok) {
+        return false;
+    }
+    cancel_until(s, 0);
+
+    int* clause_lits = malloc(sizeof(int) * (num_lits + 1));
+    int size = 0;
+    int i, j;
+    for (i = 0; i < num_lits; i++) {
+        int var = lits[i] > 0 ? lits[i] : -lits[i];
+        while (s->num_vars < var) {
+            sat_new_var(s);
+        }
+        int lit = from_dimacs(lits[i]);
+
+        /* Skip satisfied clauses and drop false or repeated literals. */
+        if (lit_value(s, lit) == 1) {
+            free(clause_lits);
+            return true;
+        }
+        if (lit_value(s, lit) == -1) {
+            continue;
+        }
+        bool duplicate = false;
+        for (j = 0; j < size; j++) {
+            if (clause_lits[j] == (lit ^ 1)) {
+                free(clause_lits);
+                return true;
+            }
+            if (clause_lits[j] == lit) {
+                duplicate = true;
+            }
+        }
+        if (!duplicate) {
+            clause_lits[size++] = lit;
+        }
+    }
+
+    if (size == 0) {
+        s->ok = false;
+    }
+    else if (size == 1) {
+        enqueue(s, clause_lits[0], CLAUSE_NONE);
+        s->ok = (propagate(s) == CLAUSE_NONE);
+    }
+    else {
+        attach_clause(s, clause_lits, size, false);
+    }
+    free(clause_lits);
+    return s->ok;
+}
+
+/*
+ * Delete the clauses that have a literal assigned true at level 0, which
+ * stays true for every later call, as do the learnt clauses. Return false
+ * if the clause set became unsatisfiable.
+ */
+bool sat_simplify(Solver s) {
+    if (!s->ok) {
+        return false;
+    }
+    cancel_until(s, 0);
+    if (propagate(s) != CLAUSE_NONE) {
+        s->ok = false;
+        return false;
+    }
+    bool removed = false;
+    int i, k;
+    for (i = 0; i < s->num_clauses; i++) {
+        clause* c = s->clauses[i];
+        if (c == NULL) {
+            continue;
+        }
+        k = 0;
+        while (k < c->size && lit_value(s, c->lits[k]) != 1) {
+            k++;
+        }
+        if (k == c->size) {
+            continue;
+        }
+        if (c->learnt) {
+            s->num_learnts--;
+        }
+        free(c);
+        s->clauses[i] = NULL;
+        removed = true;
+    }
+
+    /* Assignments at level 0 are never explained, so their reasons can go. */
+    for (i = 0; i < s->trail_size; i++) {
+        s->reason[lit_var(s->trail[i])] = CLAUSE_NONE;
+    }
+    if (removed) {
+        purge_deleted(s);
+    }
+    return true;
+}
+
+/*
+ * Decide satisfiability of the clauses added so far, with the given
+ * DIMACS literals assumed true. On success the model can be read with
+ * sat_model_value().
+ */
+bool sat_solve(Solver s, const int* assumptions, int num_assumptions) {
+    if (s->num_vars > 0) {
+        memset(s->failed, 0, sizeof(bool) * 2 * s->num_vars);
+    }
+    if (!s->ok) {
+        return false;
+    }
+    int* lits = malloc(sizeof(int) * (num_assumptions + 1));
+    int i;
+    for (i = 0; i < num_assumptions; i++) {
+        int var = assumptions[i] > 0 ? assumptions[i] : -assumptions[i];
+        while (s->num_vars < var) {
+            sat_new_var(s);
+        }
+        lits[i] = from_dimacs(assumptions[i]);
+    }
+    s->max_learnts = (s->num_clauses - s->num_learnts) / 3.0;
+    if (s->max_learnts < 100) {
+        s->max_learnts = 100;
+    }
+    s->learnts_adjust_confl = LEARNTS_ADJUST_FIRST;
+    s->learnts_adjust_count = LEARNTS_ADJUST_FIRST;
+    int status = -1;
+    int restarts = 0;
+    while (status == -1) {
+        status = search(s, lits, num_assumptions, luby(restarts) * RESTART_FIRST);
+        restarts++;
+    }
+    if (status == 1) {
+        for (i = 0; i < s->num_vars; i++) {
+            s->model[i] = (s->assigns[i] == 1);
+        }
+    }
+    cancel_until(s, 0);
+    free(lits);
+    return status == 1;
+}
+
+bool sat_model_value(Solver s, int var) {
+    return s->model[var - 1];
+}
+
+/*
+ * After sat_solve() failed under assumptions, tell whether the given
+ * assumption is one of those the unsatisfiability follows from. If no
+ * assumption is, the clauses themselves are unsatisfiable.
+ */
+bool sat_failed(Solver s, int lit) {
+    return s->failed[from_dimacs(lit)];
+}
@@ -0,0 +1,31 @@
+#ifndef SAT_H
+#define SAT_H
+
+#include <stdbool.h>
+
+/*
+ * A conflict-driven clause-learning SAT solver.
+ *
+ * Variables are numbered from 1. A literal is either a variable (positive
+ * literal) or its negation (negative literal), as in the DIMACS format.
+ * Clauses can be added between calls to sat_solve(), and each call may be
+ * given a list of literals that are assumed true for that call only. When
+ * a call fails, sat_failed() tells which assumptions were responsible.
+ *
+ * Clauses that should only hold for a while can be given an extra literal,
+ * assumed false while they should hold; once a unit clause makes it true,
+ * sat_simplify() deletes them.
+ */
+typedef struct solver *Solver;
+
+Solver sat_new(void);
+void sat_free(Solver);
+int sat_new_var(Solver);
+int sat_num_vars(Solver);
+bool sat_add_clause(Solver, const int *, int);
+bool sat_simplify(Solver);
+bool sat_solve(Solver, const int *, int);
+bool sat_model_value(Solver, int);
+bool sat_failed(Solver, int);
+
+#endif
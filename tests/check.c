@@ -0,0 +1,654 @@
+/*
+ * Checks of the formula engine through logic.h, against brute force.
+ *
+ * Build with the other sources of reason, without reason.c, and run from a
+ * directory holding the names.txt and predicates.txt of the repository:
+ *
+ *     cc -std=c99 -O2 -pthread -I. -o check tests/check.c logic.c sat.c bdd.c count.c number.c -lm
+ *     ./check witness
+ *
+ * Each check prints "ok", or a line for each formula it fails on.
+ *
+ *     witness       is_satisfiable() agrees with trying all assignments, and
+ *                   the witness of each engine is a model with as few true
+ *                   atoms as there can be
+ *     evaluation    add_fact() and retract_fact() keep evaluations that
+ *                   share an interpretation as is_true() would evaluate
+ *     reorder       reorder_formula() does not change what is_true() says
+ *     simplify      simplify_formula() applies each of its rules, and keeps
+ *                   the values of formulas given atoms known to be true or
+ *                   false
+ *     kb            a knowledge base whose groups are pushed and popped is
+ *                   consistent with a query exactly when the formulas in
+ *                   force and the query are satisfiable together
+ */
+
+/* For strdup() under plain C99. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "logic.h"
+
+#define MAX_ATOMS 8
+#define MAX_WORD 256
+
+/* Ground atoms of the vocabulary of the repository. */
+static const char* atoms[MAX_ATOMS] = {
+    "rich(paul)", "taller_than(paul,peter)", "temperature_is_now_above_25",
+    "rich(juliet)", "taller_than(juliet,melissa)", "rich(fido)",
+    "taller_than(fido,fido)", "rich(melissa)"
+};
+
+static const char* connectives[4] = {"and", "or", "implies", "iff"};
+
+static const char* engines[4] = {"auto", "sat", "bdd", "bdd-sift"};
+
+static int failures;
+
+/* ==================== Random Generation =====================*/
+
+static uint64_t rng_state = 1;
+
+/* A xorshift64* generator, so that runs can be reproduced anywhere. */
+uint64_t next_random() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+int random_below(int n) {
+    return (int)(next_random() % (uint64_t)n);
+}
+
+/*
+ * A growable string.
+ */
+typedef struct {
+    char*  data;
+    size_t size;
+    size_t capacity;
+} TEXT;
+
+void text_append(TEXT* text, const char* str) {
+    size_t len = strlen(str);
+    if (text->size + len + 1 > text->capacity) {
+        while (text->size + len + 1 > text->capacity) {
+            text->capacity = text->capacity == 0 ? 256 : 2 * text->capacity;
+        }
+        text->data = realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->size, str, len + 1);
+    text->size += len;
+}
+
+/*
+ * Append a random formula of the given depth over the first num_atoms
+ * atoms to the text.
+ */
+void make_random_formula(TEXT* text, int num_atoms, int depth) {
+    if (depth == 0 || random_below(4) == 0) {
+        text_append(text, atoms[random_below(num_atoms)]);
+        return;
+    }
+    int op = random_below(5);
+    if (op == 4) {
+        text_append(text, "not ");
+        make_random_formula(text, num_atoms, depth - 1);
+        return;
+    }
+    text_append(text, "[");
+    make_random_formula(text, num_atoms, depth - 1);
+    text_append(text, " ");
+    text_append(text, connectives[op]);
+    text_append(text, " ");
+    make_random_formula(text, num_atoms, depth - 1);
+    text_append(text, "]");
+}
+
+/*
+ * Append a conjunction of num_clauses random clauses of 2 or 3 literals
+ * over the first num_atoms atoms to the text: with many clauses, most of
+ * them are unsatisfiable, and not in a way that simplification sees.
+ */
+void make_random_clauses(TEXT* text, int num_atoms, int num_clauses) {
+    int i, k;
+    for (i = 1; i < num_clauses; i++) {
+        text_append(text, "[");
+    }
+    for (i = 0; i < num_clauses; i++) {
+        int width = 2 + random_below(2);
+        for (k = 1; k < width; k++) {
+            text_append(text, "[");
+        }
+        for (k = 0; k < width; k++) {
+            if (random_below(2) == 0) {
+                text_append(text, "not ");
+            }
+            text_append(text, atoms[random_below(num_atoms)]);
+            text_append(text, k == 0 ? " or " : k < width - 1 ? "] or " : "]");
+        }
+        text_append(text, i == 0 ? "" : "]");
+        if (i < num_clauses - 1) {
+            text_append(text, " and ");
+        }
+    }
+}
+
+Formula parse(const char* text) {
+    Formula formula = make_formula_from_string(text);
+    if (!is_syntactically_correct(formula)) {
+        printf("FAIL generated text is not a formula: %s\n", text);
+        exit(1);
+    }
+    return formula;
+}
+
+/* ==================== Brute Force =====================*/
+
+/*
+ * Make the first num_atoms atoms true or false as the bits of the mask say.
+ */
+void assign(Interpretation interp, int num_atoms, int mask) {
+    int i;
+    for (i = 0; i < num_atoms; i++) {
+        set_fact(interp, atoms[i], (mask >> i & 1) == 1);
+    }
+}
+
+int count_bits(int mask) {
+    int n = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Return the fewest atoms among the first num_atoms that are true in a model
+ * of the formula, or -1 if it has none.
+ */
+int brute_force_minimum(Formula formula, Interpretation interp, int num_atoms) {
+    int best = -1;
+    int mask;
+    for (mask = 0; mask < 1 << num_atoms; mask++) {
+        assign(interp, num_atoms, mask);
+        if ((best == -1 || count_bits(mask) < best) && is_true(formula, interp)) {
+            best = count_bits(mask);
+        }
+    }
+    return best;
+}
+
+/* ==================== Checks =====================*/
+
+/*
+ * Decide the formula with each engine, and check that it is satisfiable
+ * exactly when trying all assignments finds a model, and that the witness
+ * is then a model of the formula with the fewest true atoms.
+ */
+void check_witness(const char* text, Interpretation interp, int num_atoms) {
+    Formula formula = parse(text);
+    int best = brute_force_minimum(formula, interp, num_atoms);
+    int e;
+    for (e = 0; e < 4; e++) {
+        set_engine(engines[e]);
+        bool satisfiable = is_satisfiable(formula);
+        if (satisfiable != (best != -1)) {
+            printf("FAIL %s: %s is %s\n", engines[e], text,
+                   satisfiable ? "satisfiable" : "unsatisfiable");
+            failures++;
+            continue;
+        }
+        if (!satisfiable) {
+            continue;
+        }
+        FILE* file = tmpfile();
+        print_witness(file);
+        rewind(file);
+        assign(interp, num_atoms, 0);
+        int num_true = 0;
+        char word[MAX_WORD];
+        while (fscanf(file, "%255s", word) == 1) {
+            set_fact(interp, word, true);
+            num_true++;
+        }
+        fclose(file);
+        if (!is_true(formula, interp)) {
+            printf("FAIL %s: the witness of %s is not a model\n", engines[e], text);
+            failures++;
+        }
+        else if (num_true != best) {
+            printf("FAIL %s: the witness of %s has %d true atoms, not %d\n",
+                   engines[e], text, num_true, best);
+            failures++;
+        }
+    }
+    formula_free(formula);
+}
+
+/*
+ * Keep evaluations of random formulas, sharing one interpretation, up to
+ * date through add_fact() and retract_fact() while random facts are
+ * toggled, and check that each agrees with is_true() after each change.
+ */
+void check_evaluations() {
+    Interpretation interp = load_interpretation("/dev/null");
+    Formula formulas[4];
+    Evaluation evals[4];
+    int round, i, k;
+    for (round = 0; round < 100; round++) {
+        int num_atoms = 1 + random_below(MAX_ATOMS);
+        assign(interp, MAX_ATOMS, random_below(1 << MAX_ATOMS));
+        TEXT texts[4];
+        for (k = 0; k < 4; k++) {
+            texts[k] = (TEXT){NULL, 0, 0};
+            make_random_formula(&texts[k], num_atoms, 1 + random_below(6));
+            formulas[k] = parse(texts[k].data);
+            evals[k] = make_evaluation(formulas[k], interp);
+        }
+        for (i = 0; i < 50; i++) {
+            const char* atom = atoms[random_below(num_atoms)];
+            bool value = random_below(2) == 0;
+            for (k = 0; k < 4; k++) {
+                value ? add_fact(evals[k], atom) : retract_fact(evals[k], atom);
+            }
+            for (k = 0; k < 4; k++) {
+                if (get_truth_value(evals[k]) != is_true(formulas[k], interp)) {
+                    printf("FAIL evaluation of %s after %s %s\n", texts[k].data,
+                           value ? "adding" : "retracting", atom);
+                    failures++;
+                }
+            }
+        }
+        for (k = 0; k < 4; k++) {
+            evaluation_free(evals[k]);
+            formula_free(formulas[k]);
+            free(texts[k].data);
+        }
+    }
+    interpretation_free(interp);
+}
+
+/*
+ * Evaluate random formulas over facts where most atoms are true, then
+ * where most are false, reordering them after each round, and check after
+ * each reordering that they agree over all assignments with a copy that
+ * is never reordered.
+ */
+void check_reordering() {
+    Interpretation interp = load_interpretation("/dev/null");
+    int i, k, mask;
+    for (i = 0; i < 200; i++) {
+        int num_atoms = 1 + random_below(MAX_ATOMS);
+        TEXT text = {NULL, 0, 0};
+        make_random_formula(&text, num_atoms, 1 + random_below(6));
+        Formula formula = parse(text.data);
+        Formula reference = parse(text.data);
+        for (k = 0; k < 4; k++) {
+            int round;
+            for (round = 0; round < 64; round++) {
+                int facts = 0;
+                int j;
+                for (j = 0; j < num_atoms; j++) {
+                    facts |= (random_below(8) != 0) == (k % 2 == 0) ? 1 << j : 0;
+                }
+                assign(interp, num_atoms, facts);
+                is_true(formula, interp);
+            }
+            reorder_formula(formula);
+            for (mask = 0; mask < 1 << num_atoms; mask++) {
+                assign(interp, num_atoms, mask);
+                if (is_true(formula, interp) != is_true(reference, interp)) {
+                    printf("FAIL reordered %s differs under facts %#x\n", text.data, mask);
+                    failures++;
+                    break;
+                }
+            }
+        }
+        formula_free(formula);
+        formula_free(reference);
+        free(text.data);
+    }
+    interpretation_free(interp);
+}
+
+/*
+ * Return the number of bytes of the formula saved to a file, which grows
+ * with the size of its code.
+ */
+long saved_size(Formula formula) {
+    if (!save_formula(formula, "check_saved.bin")) {
+        return -1;
+    }
+    FILE* file = fopen("check_saved.bin", "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    remove("check_saved.bin");
+    return size;
+}
+
+/*
+ * Check that the formula simplifies to the given value, or, for -1, to a
+ * formula whose code is as large as that of the expected one.
+ */
+void check_rewrite(const char* text, int expected_value, const char* expected) {
+    Formula formula = parse(text);
+    int value;
+    Formula simple = simplify_formula(formula, NULL, NULL, &value);
+    if (value != expected_value) {
+        printf("FAIL %s simplifies to %d, not %d\n", text, value, expected_value);
+        failures++;
+    }
+    else if (expected != NULL) {
+        Formula reference = parse(expected);
+        if (saved_size(simple) != saved_size(reference)) {
+            printf("FAIL %s does not simplify to %s\n", text, expected);
+            failures++;
+        }
+        formula_free(reference);
+    }
+    formula_free(simple);
+    formula_free(formula);
+}
+
+/*
+ * Check each rewriting rule of simplify_formula(), then that random
+ * formulas simplified with random atoms known to be true or false keep
+ * their values under all assignments that agree with what is known.
+ */
+void check_simplification() {
+    check_rewrite("not not rich(paul)", -1, "rich(paul)");
+    check_rewrite("not not not rich(paul)", -1, "not rich(paul)");
+    check_rewrite("[rich(paul) and not rich(paul)]", 0, NULL);
+    check_rewrite("[not rich(paul) or rich(paul)]", 1, NULL);
+    check_rewrite("[rich(paul) iff rich(paul)]", 1, NULL);
+    check_rewrite("[rich(paul) iff not rich(paul)]", 0, NULL);
+    check_rewrite("not [rich(paul) iff rich(paul)]", 0, NULL);
+    check_rewrite("[rich(paul) implies rich(paul)]", 1, NULL);
+    check_rewrite("[rich(paul) and [rich(paul) or rich(fido)]]", -1, "rich(paul)");
+    check_rewrite("[[rich(fido) and rich(paul)] or rich(paul)]", -1, "rich(paul)");
+    check_rewrite("[rich(paul) and [rich(fido) and rich(paul)]]", -1,
+                  "[rich(paul) and rich(fido)]");
+    check_rewrite("[rich(paul) and [not rich(paul) or rich(fido)]]", -1,
+                  "[rich(paul) and rich(fido)]");
+    check_rewrite("[rich(paul) or [not rich(paul) and rich(fido)]]", -1,
+                  "[rich(paul) or rich(fido)]");
+    check_rewrite("not [rich(paul) implies rich(fido)]", -1,
+                  "[rich(paul) and not rich(fido)]");
+    /* Atoms with one parent are neither stored nor loaded. */
+    check_rewrite("[[rich(paul) and rich(fido)] or [rich(juliet) and not rich(melissa)]]",
+                  -1, "[[rich(paul) and rich(fido)] or [rich(juliet) and not rich(melissa)]]");
+
+    Interpretation interp = load_interpretation("/dev/null");
+    Interpretation known_true = load_interpretation("/dev/null");
+    Interpretation known_false = load_interpretation("/dev/null");
+    int i, j, mask;
+    for (i = 0; i < 300; i++) {
+        int num_atoms = 1 + random_below(MAX_ATOMS);
+        TEXT text = {NULL, 0, 0};
+        make_random_formula(&text, num_atoms, 1 + random_below(6));
+        Formula formula = parse(text.data);
+        int known = 0;
+        int facts = 0;
+        for (j = 0; j < num_atoms; j++) {
+            int r = i % 3 == 0 ? 0 : random_below(4);
+            known |= r > 1 ? 1 << j : 0;
+            facts |= r == 3 ? 1 << j : 0;
+            set_fact(known_true, atoms[j], r == 3);
+            set_fact(known_false, atoms[j], r == 2);
+        }
+        int value;
+        Formula simple = simplify_formula(formula, known_true, known_false, &value);
+        for (mask = 0; mask < 1 << num_atoms; mask++) {
+            if ((mask & known) != facts) {
+                continue;
+            }
+            assign(interp, num_atoms, mask);
+            bool truth = value == -1 ? is_true(simple, interp) : value == 1;
+            if (truth != is_true(formula, interp)) {
+                printf("FAIL %s simplified with facts %#x known among %#x differs under %#x\n",
+                       text.data, facts, known, mask);
+                failures++;
+                break;
+            }
+        }
+        formula_free(simple);
+        formula_free(formula);
+        free(text.data);
+    }
+    interpretation_free(interp);
+    interpretation_free(known_true);
+    interpretation_free(known_false);
+}
+
+/*
+ * Return the number of connectives of the text of a formula.
+ */
+int count_connectives(const char* text) {
+    int count = 0;
+    const char* p;
+    for (p = text; *p != '\0'; p++) {
+        count += *p == '[' || strncmp(p, "not ", 4) == 0;
+    }
+    return count;
+}
+
+void add_to_knowledge_base(KnowledgeBase kb, const char* text) {
+    Formula formula = parse(text);
+    add_formula(kb, formula);
+    formula_free(formula);
+}
+
+/*
+ * Return whether the formulas in force, and the query unless it is NULL,
+ * are satisfiable together, and check that the witness of the knowledge
+ * base, which answered is_consistent, is then a model of them.
+ */
+bool expect_consistent(TEXT* in_force, int num_in_force, const char* query,
+                       bool is_consistent, Interpretation interp) {
+    TEXT text = {NULL, 0, 0};
+    int i;
+    for (i = 0; i < num_in_force; i++) {
+        text_append(&text, "[");
+    }
+    text_append(&text, query != NULL ? query : "[rich(paul) or not rich(paul)]");
+    for (i = 0; i < num_in_force; i++) {
+        text_append(&text, " and ");
+        text_append(&text, in_force[i].data);
+        text_append(&text, "]");
+    }
+    Formula formula = parse(text.data);
+    bool satisfiable = is_satisfiable(formula);
+    if (satisfiable && is_consistent) {
+        FILE* file = tmpfile();
+        print_witness(file);
+        rewind(file);
+        assign(interp, MAX_ATOMS, 0);
+        char word[MAX_WORD];
+        while (fscanf(file, "%255s", word) == 1) {
+            set_fact(interp, word, true);
+        }
+        fclose(file);
+        if (!is_true(formula, interp)) {
+            printf("FAIL the witness of the knowledge base is not a model of %s\n", text.data);
+            failures++;
+        }
+    }
+    formula_free(formula);
+    free(text.data);
+    return satisfiable;
+}
+
+/*
+ * Query a knowledge base, and check its answer and witness against the
+ * formulas in force.
+ */
+void check_query(KnowledgeBase kb, TEXT* in_force, int num_in_force, const char* query,
+                 Interpretation interp) {
+    Formula formula = query != NULL ? parse(query) : NULL;
+    bool consistent = is_consistent_with(kb, formula);
+    if (expect_consistent(in_force, num_in_force, query, consistent, interp) != consistent) {
+        printf("FAIL the knowledge base of %d formulas is %s with %s\n", num_in_force,
+               consistent ? "consistent" : "inconsistent", query != NULL ? query : "nothing");
+        failures++;
+    }
+    if (formula != NULL) {
+        formula_free(formula);
+    }
+}
+
+/*
+ * Push a contradiction in a group and pop it, then push, assert and pop
+ * random formulas in nested groups while querying the knowledge base with
+ * random formulas, checking each answer against is_satisfiable() on the
+ * formulas in force and the query. The connectives of the queries and of
+ * the groups popped come to many times KB_MIN_RETIRED of logic.c, so the
+ * knowledge base deletes their clauses over and over as it goes.
+ */
+void check_knowledge_base() {
+    Interpretation interp = load_interpretation("/dev/null");
+    KnowledgeBase kb = make_knowledge_base();
+    TEXT in_force[64];
+    int group_starts[8];
+    int num_in_force = 0;
+    int num_groups = 0;
+    long num_connectives = 0;
+    int i;
+
+    in_force[num_in_force] = (TEXT){NULL, 0, 0};
+    text_append(&in_force[num_in_force++], "rich(paul)");
+    add_to_knowledge_base(kb, "rich(paul)");
+    check_query(kb, in_force, num_in_force, NULL, interp);
+    push_group(kb);
+    in_force[num_in_force] = (TEXT){NULL, 0, 0};
+    text_append(&in_force[num_in_force++], "not rich(paul)");
+    add_to_knowledge_base(kb, "not rich(paul)");
+    if (is_consistent_with(kb, NULL)) {
+        printf("FAIL the knowledge base is consistent with a contradiction\n");
+        failures++;
+    }
+    if (!pop_group(kb)) {
+        printf("FAIL the group of the contradiction does not pop\n");
+        failures++;
+    }
+    free(in_force[--num_in_force].data);
+    if (!is_consistent_with(kb, NULL)) {
+        printf("FAIL the knowledge base is inconsistent after popping the contradiction\n");
+        failures++;
+    }
+    check_query(kb, in_force, num_in_force, "not rich(paul)", interp);
+    check_query(kb, in_force, num_in_force, "[rich(paul) and rich(juliet)]", interp);
+    if (pop_group(kb)) {
+        printf("FAIL a knowledge base without groups pops one\n");
+        failures++;
+    }
+
+    for (i = 0; i < 4000; i++) {
+        int step = random_below(8);
+        if (step == 0 && num_groups < 8) {
+            push_group(kb);
+            group_starts[num_groups++] = num_in_force;
+        }
+        else if (step == 1 && num_groups > 0) {
+            pop_group(kb);
+            num_groups--;
+            while (num_in_force > group_starts[num_groups]) {
+                free(in_force[--num_in_force].data);
+            }
+        }
+        else if (step == 2 && num_groups > 0 && num_in_force < 64) {
+            in_force[num_in_force] = (TEXT){NULL, 0, 0};
+            make_random_formula(&in_force[num_in_force], MAX_ATOMS, 1 + random_below(4));
+            add_to_knowledge_base(kb, in_force[num_in_force++].data);
+        }
+        else if (step == 3) {
+            check_query(kb, in_force, num_in_force, NULL, interp);
+        }
+        else {
+            TEXT query = {NULL, 0, 0};
+            make_random_formula(&query, MAX_ATOMS, 2 + random_below(4));
+            check_query(kb, in_force, num_in_force, query.data, interp);
+            num_connectives += count_connectives(query.data);
+            free(query.data);
+        }
+    }
+    if (num_connectives < 4 * 1024) {
+        printf("FAIL the queries come to only about %ld connectives\n", num_connectives);
+        failures++;
+    }
+    while (num_in_force > 0) {
+        free(in_force[--num_in_force].data);
+    }
+    knowledge_base_free(kb);
+    interpretation_free(interp);
+}
+
+void check_witnesses() {
+    Interpretation interp = load_interpretation("/dev/null");
+    int num_unsatisfiable = 0;
+    int i;
+    check_witness("[rich(paul) and not rich(paul)]", interp, 1);
+    check_witness("[[rich(paul) iff not rich(fido)] and [rich(paul) iff rich(fido)]]",
+                  interp, MAX_ATOMS);
+    for (i = 0; i < 400; i++) {
+        int num_atoms = 2 + random_below(MAX_ATOMS - 1);
+        TEXT text = {NULL, 0, 0};
+        if (i % 2 == 0) {
+            make_random_formula(&text, num_atoms, 2 + random_below(4));
+        }
+        else {
+            make_random_clauses(&text, num_atoms, num_atoms + random_below(4 * num_atoms));
+        }
+        Formula formula = parse(text.data);
+        num_unsatisfiable += brute_force_minimum(formula, interp, num_atoms) == -1;
+        formula_free(formula);
+        check_witness(text.data, interp, num_atoms);
+        free(text.data);
+    }
+    if (num_unsatisfiable < 20) {
+        printf("FAIL only %d random formulas are unsatisfiable\n", num_unsatisfiable);
+        failures++;
+    }
+    interpretation_free(interp);
+    set_engine("auto");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s witness|evaluation|reorder|simplify|kb\n", argv[0]);
+        return 2;
+    }
+    if (!load_constants("names.txt") || !load_predicates("predicates.txt")) {
+        fprintf(stderr, "Could not read names.txt and predicates.txt\n");
+        return 2;
+    }
+    set_witness_to_file(false);
+    if (!strcmp(argv[1], "witness")) {
+        check_witnesses();
+    }
+    else if (!strcmp(argv[1], "evaluation")) {
+        check_evaluations();
+    }
+    else if (!strcmp(argv[1], "reorder")) {
+        check_reordering();
+    }
+    else if (!strcmp(argv[1], "simplify")) {
+        check_simplification();
+    }
+    else if (!strcmp(argv[1], "kb")) {
+        check_knowledge_base();
+    }
+    else {
+        fprintf(stderr, "Unknown check %s\n", argv[1]);
+        return 2;
+    }
+    if (failures == 0) {
+        printf("ok\n");
+    }
+    return failures != 0;
+}
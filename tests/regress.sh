@@ -0,0 +1,202 @@
+#!/bin/sh
+#
+# Regression tests for reason. Builds it, and the checks of tests/check.c,
+# from the sources of the parent directory, then runs each case in a
+# scratch directory holding a copy of its names.txt, predicates.txt and
+# true_atoms.txt, and compares what it prints with what is expected.
+#
+#     sh tests/regress.sh
+
+cd "$(dirname "$0")/.." || exit 1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cc -std=c99 -O2 -pthread -o "$work/reason" reason.c logic.c sat.c bdd.c count.c number.c -lm || exit 1
+cc -std=c99 -O2 -pthread -I. -o "$work/check" tests/check.c logic.c sat.c bdd.c count.c number.c -lm || exit 1
+cp names.txt predicates.txt true_atoms.txt "$work"
+cd "$work" || exit 1
+
+failed=0
+
+# check NAME EXPECTED COMMAND...: run the command and compare what it
+# prints with EXPECTED.
+check() {
+    name=$1
+    expected=$2
+    shift 2
+    got=$("$@" 2>&1)
+    if [ "$got" != "$expected" ]; then
+        printf 'FAIL %s\n  expected: %s\n  got:      %s\n' "$name" "$expected" "$got"
+        failed=1
+    fi
+}
+
+# A formula whose last token ends the input, with no newline after it.
+check "no trailing newline, negation" \
+"Input possible formula: Possible formula is indeed a formula.
+Formula is false in given interpretation.
+Formula is satisfiable." \
+    sh -c 'printf "not rich(paul)" | "$0"' "$work/reason"
+check "no trailing newline, binary atom" \
+"Input possible formula: Possible formula is indeed a formula.
+Formula is true in given interpretation." \
+    sh -c 'printf "not taller_than(paul,juliet)" | "$0"' "$work/reason"
+check "no trailing newline, batch" \
+"1	true
+2	true" \
+    sh -c 'printf "rich(paul)\nnot rich(juliet)" | "$0" --batch' "$work/reason"
+
+# A compiled formula that loads slot 0, which it never stored: the header
+# of a saved formula, for its fingerprint, with num_atoms 0, num_args 0,
+# size 1, max_depth 1, num_slots 1, then operand 0 and OP_LOAD.
+echo "rich(paul)" | "$work/reason" --save saved.bin > /dev/null
+{
+    head -c 16 saved.bin
+    printf '\000\000\000\000\000\000\000\000\001\000\000\000\001\000\000\000'
+    printf '\001\000\000\000\000\000\000\000\000\000\000\000\007'
+} > load_unstored.bin
+check "load of a slot never stored" \
+"Could not load formula file. Bye!" \
+    "$work/reason" --load load_unstored.bin
+check "saved formula loads" \
+"Possible formula is indeed a formula.
+Formula is true in given interpretation." \
+    "$work/reason" --load saved.bin
+
+# The models of a chain of 64 atoms joined by iff, counted with the engine
+# left to choose and on the clauses alone, each within 10 seconds.
+mkdir chain
+(
+    cd chain || exit 1
+    i=0
+    chain="p(n0)"
+    while [ $i -lt 64 ]; do
+        printf 'n%d ' $i >> names.txt
+        [ $i -gt 0 ] && chain="[$chain iff p(n$i)]"
+        i=$((i + 1))
+    done
+    echo "p/1" > predicates.txt
+    : > true_atoms.txt
+    printf 'count %s\nquit\n' "$chain" > requests.txt
+)
+check "count of an iff chain" "ok 9223372036854775808" \
+    sh -c 'cd chain && timeout 10 "$0" --serve < requests.txt' "$work/reason"
+check "count of an iff chain on the clauses" "ok 9223372036854775808" \
+    sh -c 'cd chain && timeout 10 "$0" --serve --engine sat < requests.txt' "$work/reason"
+
+# The models of random formulas over 15 to 25 atoms, counted on the clauses
+# as by a BDD, within 10 seconds.
+mkdir random
+(
+    cd random || exit 1
+    i=0
+    while [ $i -lt 25 ]; do
+        printf 'n%d ' $i >> names.txt
+        i=$((i + 1))
+    done
+    echo "p/1" > predicates.txt
+    : > true_atoms.txt
+    awk 'function f(n, d,  r) {
+             if (d == 0) return "p(n" int(rand() * n) ")"
+             r = rand()
+             if (r < 0.15) return "not " f(n, d - 1)
+             return "[" f(n, d - 1) " " op[int(rand() * 4)] " " f(n, d - 1) "]"
+         }
+         BEGIN {
+             split("and or implies iff", op, " ")
+             op[0] = op[4]
+             for (s = 1; s <= 8; s++) { srand(s); print "count " f(15 + 5 * (s % 3), 8 + s % 3) }
+             print "quit"
+         }' > requests.txt
+    "$work/reason" --serve --engine bdd < requests.txt > expected.txt
+)
+check "count of random formulas on the clauses" "$(cat random/expected.txt)" \
+    sh -c 'cd random && timeout 10 "$0" --serve --engine sat < requests.txt' "$work/reason"
+
+# Deep random formulas over 3000 atoms, whose BDDs are too large, decided
+# with the BDD engine as with the engine left to choose, within 5 seconds.
+mkdir deep
+(
+    cd deep || exit 1
+    i=0
+    while [ $i -lt 3000 ]; do
+        printf 'n%d ' $i >> names.txt
+        i=$((i + 1))
+    done
+    echo "p/1" > predicates.txt
+    : > true_atoms.txt
+    awk 'function f(d,  r) {
+             if (d == 0) return "p(n" int(rand() * 3000) ")"
+             r = rand()
+             if (r < 0.15) return "not " f(d - 1)
+             return "[" f(d - 1) " " op[int(rand() * 4)] " " f(d - 1) "]"
+         }
+         BEGIN {
+             split("and or implies iff", op, " ")
+             op[0] = op[4]
+             for (s = 1; s <= 6; s++) { srand(s); print f(11) }
+         }' > formulas.txt
+    "$work/reason" --batch formulas.txt | cut -f 1,2 > expected.txt
+)
+check "deep formulas with the BDD engine" "$(cat deep/expected.txt)" \
+    sh -c 'cd deep && timeout 5 "$0" --batch formulas.txt --engine bdd | cut -f 1,2' \
+    "$work/reason"
+
+# Satisfiability and minimal witnesses of random formulas over a few atoms,
+# some of them unsatisfiable, for each engine, against trying all
+# assignments.
+check "minimal witnesses" "ok" "$work/check" witness
+
+# Evaluations kept up to date as facts are added and retracted, through
+# the API and by a session, whose cached evaluations must follow the facts.
+check "evaluations after each change of facts" "ok" "$work/check" evaluation
+check "session evaluations after each change of facts" \
+"ok true
+ok false
+ok
+ok true
+ok false
+ok
+ok false
+ok true
+ok
+ok true
+ok
+ok true
+ok true" \
+    sh -c 'printf "%s\n" "eval rich(paul)" "eval [rich(paul) and rich(juliet)]" \
+        "add rich(juliet)" "eval rich(paul)" "eval not [rich(paul) and rich(juliet)]" \
+        "retract rich(paul)" "eval rich(paul)" "eval [rich(paul) iff rich(melissa)]" \
+        "add rich(paul)" "eval [rich(paul) and rich(juliet)]" \
+        "reload" "eval [rich(paul) or rich(juliet)]" "eval rich(paul)" | "$0" --serve' \
+    "$work/reason"
+
+# Formulas reordered after being evaluated over facts that are mostly true,
+# then mostly false, keep their values under all assignments.
+check "values kept by reordering" "ok" "$work/check" reorder
+
+# The rules of simplification, and random formulas simplified given atoms
+# known to be true or false, against trying all assignments.
+check "simplification" "ok" "$work/check" simplify
+
+# A knowledge base consistent again once the group holding a contradiction
+# is popped, by a session and through the API, where random groups and
+# queries retire enough connectives for their clauses to be deleted.
+check "session consistent again after a pop" \
+"ok
+ok
+ok
+ok not satisfiable
+ok
+ok satisfiable rich(paul)
+ok not satisfiable
+ok satisfiable rich(paul) rich(juliet)
+error no group to pop" \
+    sh -c 'printf "%s\n" "assert rich(paul)" "push" "assert not rich(paul)" "query" "pop" \
+        "query" "query not rich(paul)" "query [rich(juliet) and rich(paul)]" "pop" | "$0" --serve' \
+    "$work/reason"
+check "knowledge base through pops and deletions" "ok" "$work/check" kb
+
+if [ $failed -eq 0 ]; then
+    echo "All tests passed."
+fi
+exit $failed